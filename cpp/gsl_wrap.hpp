@@ -0,0 +1,648 @@
+#ifndef GSL_WRAP_HPP_
+#define GSL_WRAP_HPP_
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <cmath>
+
+// Element-wise vector operations on fewer than SOLVER_OMP_MIN_LEN elements
+// run serially, since the cost of starting a parallel region would exceed
+// the gain (see also prox_lib.hpp).
+#ifndef SOLVER_OMP_MIN_LEN
+#define SOLVER_OMP_MIN_LEN 8192
+#endif
+
+// All BLAS calls go through GSL, which forwards them to whichever CBLAS
+// library is linked (see BLAS in the Makefile). If SOLVER_LAPACK is defined,
+// the Cholesky factorization and solve additionally use the LAPACK routines
+// ?potrf and ?potrs of that library instead of GSL's unblocked versions.
+#ifdef SOLVER_LAPACK
+extern "C" {
+void dpotrf_(const char *uplo, const int *n, double *a, const int *lda,
+             int *info);
+void spotrf_(const char *uplo, const int *n, float *a, const int *lda,
+             int *info);
+void dpotrs_(const char *uplo, const int *n, const int *nrhs, const double *a,
+             const int *lda, double *b, const int *ldb, int *info);
+void spotrs_(const char *uplo, const int *n, const int *nrhs, const float *a,
+             const int *lda, float *b, const int *ldb, int *info);
+}
+#endif  // SOLVER_LAPACK
+
+// Type-generic wrappers around the double and float interfaces of GSL, so that
+// the CPU solver can be written once for both precisions (in the same way as
+// cml/ for the GPU). Functions taking a vector or matrix are overloaded, while
+// allocation functions are templated on the element type. Only the subset
+// of GSL used by the solver is covered.
+namespace gsl {
+
+template <typename T>
+struct Types;
+
+template <>
+struct Types<double> {
+  typedef gsl_vector vector;
+  typedef gsl_vector_view vector_view;
+  typedef gsl_vector_const_view vector_const_view;
+  typedef gsl_matrix matrix;
+  typedef gsl_matrix_view matrix_view;
+  typedef gsl_matrix_const_view matrix_const_view;
+};
+
+template <>
+struct Types<float> {
+  typedef gsl_vector_float vector;
+  typedef gsl_vector_float_view vector_view;
+  typedef gsl_vector_float_const_view vector_const_view;
+  typedef gsl_matrix_float matrix;
+  typedef gsl_matrix_float_view matrix_view;
+  typedef gsl_matrix_float_const_view matrix_const_view;
+};
+
+template <typename T>
+using vector = typename Types<T>::vector;
+template <typename T>
+using vector_view = typename Types<T>::vector_view;
+template <typename T>
+using vector_const_view = typename Types<T>::vector_const_view;
+template <typename T>
+using matrix = typename Types<T>::matrix;
+template <typename T>
+using matrix_view = typename Types<T>::matrix_view;
+template <typename T>
+using matrix_const_view = typename Types<T>::matrix_const_view;
+
+// Allocation.
+template <typename T>
+vector<T> *vector_alloc(size_t n);
+
+template <>
+inline vector<double> *vector_alloc<double>(size_t n) {
+  return gsl_vector_alloc(n);
+}
+
+template <>
+inline vector<float> *vector_alloc<float>(size_t n) {
+  return gsl_vector_float_alloc(n);
+}
+
+template <typename T>
+vector<T> *vector_calloc(size_t n);
+
+template <>
+inline vector<double> *vector_calloc<double>(size_t n) {
+  return gsl_vector_calloc(n);
+}
+
+template <>
+inline vector<float> *vector_calloc<float>(size_t n) {
+  return gsl_vector_float_calloc(n);
+}
+
+template <typename T>
+matrix<T> *matrix_alloc(size_t m, size_t n);
+
+template <>
+inline matrix<double> *matrix_alloc<double>(size_t m, size_t n) {
+  return gsl_matrix_alloc(m, n);
+}
+
+template <>
+inline matrix<float> *matrix_alloc<float>(size_t m, size_t n) {
+  return gsl_matrix_float_alloc(m, n);
+}
+
+template <typename T>
+matrix<T> *matrix_calloc(size_t m, size_t n);
+
+template <>
+inline matrix<double> *matrix_calloc<double>(size_t m, size_t n) {
+  return gsl_matrix_calloc(m, n);
+}
+
+template <>
+inline matrix<float> *matrix_calloc<float>(size_t m, size_t n) {
+  return gsl_matrix_float_calloc(m, n);
+}
+
+inline void vector_free(gsl_vector *x) { gsl_vector_free(x); }
+inline void vector_free(gsl_vector_float *x) { gsl_vector_float_free(x); }
+
+inline void matrix_free(gsl_matrix *A) { gsl_matrix_free(A); }
+inline void matrix_free(gsl_matrix_float *A) { gsl_matrix_float_free(A); }
+
+// Views.
+inline gsl_vector_view vector_view_array(double *x, size_t n) {
+  return gsl_vector_view_array(x, n);
+}
+
+inline gsl_vector_float_view vector_view_array(float *x, size_t n) {
+  return gsl_vector_float_view_array(x, n);
+}
+
+inline gsl_vector_view vector_subvector(gsl_vector *x, size_t offset,
+                                        size_t n) {
+  return gsl_vector_subvector(x, offset, n);
+}
+
+inline gsl_vector_float_view vector_subvector(gsl_vector_float *x,
+                                              size_t offset, size_t n) {
+  return gsl_vector_float_subvector(x, offset, n);
+}
+
+inline gsl_vector_const_view vector_const_subvector(const gsl_vector *x,
+                                                    size_t offset, size_t n) {
+  return gsl_vector_const_subvector(x, offset, n);
+}
+
+inline gsl_vector_float_const_view vector_const_subvector(
+    const gsl_vector_float *x, size_t offset, size_t n) {
+  return gsl_vector_float_const_subvector(x, offset, n);
+}
+
+inline gsl_matrix_const_view matrix_const_view_array(const double *A,
+                                                     size_t m, size_t n) {
+  return gsl_matrix_const_view_array(A, m, n);
+}
+
+inline gsl_matrix_float_const_view matrix_const_view_array(const float *A,
+                                                           size_t m,
+                                                           size_t n) {
+  return gsl_matrix_float_const_view_array(A, m, n);
+}
+
+inline gsl_vector_view matrix_row(gsl_matrix *A, size_t i) {
+  return gsl_matrix_row(A, i);
+}
+
+inline gsl_vector_float_view matrix_row(gsl_matrix_float *A, size_t i) {
+  return gsl_matrix_float_row(A, i);
+}
+
+inline gsl_vector_view matrix_column(gsl_matrix *A, size_t j) {
+  return gsl_matrix_column(A, j);
+}
+
+inline gsl_vector_float_view matrix_column(gsl_matrix_float *A, size_t j) {
+  return gsl_matrix_float_column(A, j);
+}
+
+inline gsl_matrix_view matrix_submatrix(gsl_matrix *A, size_t i, size_t j,
+                                        size_t m, size_t n) {
+  return gsl_matrix_submatrix(A, i, j, m, n);
+}
+
+inline gsl_matrix_float_view matrix_submatrix(gsl_matrix_float *A, size_t i,
+                                              size_t j, size_t m, size_t n) {
+  return gsl_matrix_float_submatrix(A, i, j, m, n);
+}
+
+// Element access.
+inline double vector_get(const gsl_vector *x, size_t i) {
+  return gsl_vector_get(x, i);
+}
+
+inline float vector_get(const gsl_vector_float *x, size_t i) {
+  return gsl_vector_float_get(x, i);
+}
+
+inline void vector_set(gsl_vector *x, size_t i, double val) {
+  gsl_vector_set(x, i, val);
+}
+
+inline void vector_set(gsl_vector_float *x, size_t i, float val) {
+  gsl_vector_float_set(x, i, val);
+}
+
+inline double *vector_ptr(gsl_vector *x, size_t i) {
+  return gsl_vector_ptr(x, i);
+}
+
+inline float *vector_ptr(gsl_vector_float *x, size_t i) {
+  return gsl_vector_float_ptr(x, i);
+}
+
+inline double matrix_get(const gsl_matrix *A, size_t i, size_t j) {
+  return gsl_matrix_get(A, i, j);
+}
+
+inline float matrix_get(const gsl_matrix_float *A, size_t i, size_t j) {
+  return gsl_matrix_float_get(A, i, j);
+}
+
+inline void matrix_set(gsl_matrix *A, size_t i, size_t j, double val) {
+  gsl_matrix_set(A, i, j, val);
+}
+
+inline void matrix_set(gsl_matrix_float *A, size_t i, size_t j, float val) {
+  gsl_matrix_float_set(A, i, j, val);
+}
+
+inline double *matrix_ptr(gsl_matrix *A, size_t i, size_t j) {
+  return gsl_matrix_ptr(A, i, j);
+}
+
+inline float *matrix_ptr(gsl_matrix_float *A, size_t i, size_t j) {
+  return gsl_matrix_float_ptr(A, i, j);
+}
+
+inline const double *matrix_const_ptr(const gsl_matrix *A, size_t i,
+                                      size_t j) {
+  return gsl_matrix_const_ptr(A, i, j);
+}
+
+inline const float *matrix_const_ptr(const gsl_matrix_float *A, size_t i,
+                                     size_t j) {
+  return gsl_matrix_float_const_ptr(A, i, j);
+}
+
+// Vector and matrix operations. The element-wise operations are
+// parallelized with OpenMP for vectors of unit stride and at least
+// SOLVER_OMP_MIN_LEN elements, and otherwise call GSL.
+template <typename V>
+inline bool use_omp(const V *x) {
+  return x->stride == 1 && x->size >= SOLVER_OMP_MIN_LEN;
+}
+
+template <typename V>
+inline bool use_omp(const V *x, const V *y) {
+  return use_omp(x) && y->stride == 1;
+}
+
+template <typename T>
+void omp_memcpy(size_t n, T *x, const T *y) {
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    x[i] = y[i];
+}
+
+template <typename T>
+void omp_set_all(size_t n, T *x, T val) {
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    x[i] = val;
+}
+
+template <typename T>
+void omp_add(size_t n, T *x, const T *y) {
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    x[i] += y[i];
+}
+
+template <typename T>
+void omp_sub(size_t n, T *x, const T *y) {
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    x[i] -= y[i];
+}
+
+template <typename T>
+void omp_mul(size_t n, T *x, const T *y) {
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    x[i] *= y[i];
+}
+
+template <typename T>
+void omp_scale(size_t n, T *x, T alpha) {
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    x[i] *= alpha;
+}
+
+inline void vector_memcpy(gsl_vector *x, const gsl_vector *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_memcpy(x->size, x->data, y->data);
+  else
+    gsl_vector_memcpy(x, y);
+}
+
+inline void vector_memcpy(gsl_vector_float *x, const gsl_vector_float *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_memcpy(x->size, x->data, y->data);
+  else
+    gsl_vector_float_memcpy(x, y);
+}
+
+inline void vector_set_all(gsl_vector *x, double val) {
+  if (use_omp(x))
+    omp_set_all(x->size, x->data, val);
+  else
+    gsl_vector_set_all(x, val);
+}
+
+inline void vector_set_all(gsl_vector_float *x, float val) {
+  if (use_omp(x))
+    omp_set_all(x->size, x->data, val);
+  else
+    gsl_vector_float_set_all(x, val);
+}
+
+inline void vector_set_zero(gsl_vector *x) { vector_set_all(x, 0.0); }
+inline void vector_set_zero(gsl_vector_float *x) { vector_set_all(x, 0.0f); }
+
+inline void vector_add(gsl_vector *x, const gsl_vector *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_add(x->size, x->data, y->data);
+  else
+    gsl_vector_add(x, y);
+}
+
+inline void vector_add(gsl_vector_float *x, const gsl_vector_float *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_add(x->size, x->data, y->data);
+  else
+    gsl_vector_float_add(x, y);
+}
+
+inline void vector_sub(gsl_vector *x, const gsl_vector *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_sub(x->size, x->data, y->data);
+  else
+    gsl_vector_sub(x, y);
+}
+
+inline void vector_sub(gsl_vector_float *x, const gsl_vector_float *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_sub(x->size, x->data, y->data);
+  else
+    gsl_vector_float_sub(x, y);
+}
+
+inline void vector_mul(gsl_vector *x, const gsl_vector *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_mul(x->size, x->data, y->data);
+  else
+    gsl_vector_mul(x, y);
+}
+
+inline void vector_mul(gsl_vector_float *x, const gsl_vector_float *y) {
+  if (use_omp(x, y) && x->size == y->size)
+    omp_mul(x->size, x->data, y->data);
+  else
+    gsl_vector_float_mul(x, y);
+}
+
+inline void vector_scale(gsl_vector *x, double alpha) {
+  if (use_omp(x))
+    omp_scale(x->size, x->data, alpha);
+  else
+    gsl_vector_scale(x, alpha);
+}
+
+inline void vector_scale(gsl_vector_float *x, float alpha) {
+  if (use_omp(x))
+    omp_scale(x->size, x->data, alpha);
+  else
+    gsl_vector_float_scale(x, alpha);
+}
+
+inline void matrix_memcpy(gsl_matrix *A, const gsl_matrix *B) {
+  gsl_matrix_memcpy(A, B);
+}
+
+inline void matrix_memcpy(gsl_matrix_float *A, const gsl_matrix_float *B) {
+  gsl_matrix_float_memcpy(A, B);
+}
+
+inline void matrix_scale(gsl_matrix *A, double alpha) {
+  gsl_matrix_scale(A, alpha);
+}
+
+inline void matrix_scale(gsl_matrix_float *A, float alpha) {
+  gsl_matrix_float_scale(A, alpha);
+}
+
+inline void matrix_sub(gsl_matrix *A, const gsl_matrix *B) {
+  gsl_matrix_sub(A, B);
+}
+
+inline void matrix_sub(gsl_matrix_float *A, const gsl_matrix_float *B) {
+  gsl_matrix_float_sub(A, B);
+}
+
+// BLAS.
+inline double blas_nrm2(const gsl_vector *x) { return gsl_blas_dnrm2(x); }
+inline float blas_nrm2(const gsl_vector_float *x) { return gsl_blas_snrm2(x); }
+
+inline double blas_dot(const gsl_vector *x, const gsl_vector *y) {
+  double result;
+  gsl_blas_ddot(x, y, &result);
+  return result;
+}
+
+inline float blas_dot(const gsl_vector_float *x, const gsl_vector_float *y) {
+  float result;
+  gsl_blas_sdot(x, y, &result);
+  return result;
+}
+
+inline size_t blas_iamax(const gsl_vector *x) { return gsl_blas_idamax(x); }
+inline size_t blas_iamax(const gsl_vector_float *x) {
+  return gsl_blas_isamax(x);
+}
+
+inline void blas_axpy(double alpha, const gsl_vector *x, gsl_vector *y) {
+  gsl_blas_daxpy(alpha, x, y);
+}
+
+inline void blas_axpy(float alpha, const gsl_vector_float *x,
+                      gsl_vector_float *y) {
+  gsl_blas_saxpy(alpha, x, y);
+}
+
+inline void blas_scal(double alpha, gsl_vector *x) { gsl_blas_dscal(alpha, x); }
+inline void blas_scal(float alpha, gsl_vector_float *x) {
+  gsl_blas_sscal(alpha, x);
+}
+
+inline void blas_gemv(CBLAS_TRANSPOSE_t trans, double alpha,
+                      const gsl_matrix *A, const gsl_vector *x, double beta,
+                      gsl_vector *y) {
+  gsl_blas_dgemv(trans, alpha, A, x, beta, y);
+}
+
+inline void blas_gemv(CBLAS_TRANSPOSE_t trans, float alpha,
+                      const gsl_matrix_float *A, const gsl_vector_float *x,
+                      float beta, gsl_vector_float *y) {
+  gsl_blas_sgemv(trans, alpha, A, x, beta, y);
+}
+
+inline void blas_symv(CBLAS_UPLO_t uplo, double alpha, const gsl_matrix *A,
+                      const gsl_vector *x, double beta, gsl_vector *y) {
+  gsl_blas_dsymv(uplo, alpha, A, x, beta, y);
+}
+
+inline void blas_symv(CBLAS_UPLO_t uplo, float alpha,
+                      const gsl_matrix_float *A, const gsl_vector_float *x,
+                      float beta, gsl_vector_float *y) {
+  gsl_blas_ssymv(uplo, alpha, A, x, beta, y);
+}
+
+inline void blas_syrk(CBLAS_UPLO_t uplo, CBLAS_TRANSPOSE_t trans,
+                      double alpha, const gsl_matrix *A, double beta,
+                      gsl_matrix *C) {
+  gsl_blas_dsyrk(uplo, trans, alpha, A, beta, C);
+}
+
+inline void blas_syrk(CBLAS_UPLO_t uplo, CBLAS_TRANSPOSE_t trans,
+                      float alpha, const gsl_matrix_float *A, float beta,
+                      gsl_matrix_float *C) {
+  gsl_blas_ssyrk(uplo, trans, alpha, A, beta, C);
+}
+
+inline void blas_gemm(CBLAS_TRANSPOSE_t trans_A, CBLAS_TRANSPOSE_t trans_B,
+                      double alpha, const gsl_matrix *A, const gsl_matrix *B,
+                      double beta, gsl_matrix *C) {
+  gsl_blas_dgemm(trans_A, trans_B, alpha, A, B, beta, C);
+}
+
+inline void blas_gemm(CBLAS_TRANSPOSE_t trans_A, CBLAS_TRANSPOSE_t trans_B,
+                      float alpha, const gsl_matrix_float *A,
+                      const gsl_matrix_float *B, float beta,
+                      gsl_matrix_float *C) {
+  gsl_blas_sgemm(trans_A, trans_B, alpha, A, B, beta, C);
+}
+
+inline void blas_symm(CBLAS_SIDE_t side, CBLAS_UPLO_t uplo, double alpha,
+                      const gsl_matrix *A, const gsl_matrix *B, double beta,
+                      gsl_matrix *C) {
+  gsl_blas_dsymm(side, uplo, alpha, A, B, beta, C);
+}
+
+inline void blas_symm(CBLAS_SIDE_t side, CBLAS_UPLO_t uplo, float alpha,
+                      const gsl_matrix_float *A, const gsl_matrix_float *B,
+                      float beta, gsl_matrix_float *C) {
+  gsl_blas_ssymm(side, uplo, alpha, A, B, beta, C);
+}
+
+inline void blas_trsm(CBLAS_SIDE_t side, CBLAS_UPLO_t uplo,
+                      CBLAS_TRANSPOSE_t trans, CBLAS_DIAG_t diag, double alpha,
+                      const gsl_matrix *A, gsl_matrix *B) {
+  gsl_blas_dtrsm(side, uplo, trans, diag, alpha, A, B);
+}
+
+inline void blas_trsm(CBLAS_SIDE_t side, CBLAS_UPLO_t uplo,
+                      CBLAS_TRANSPOSE_t trans, CBLAS_DIAG_t diag, float alpha,
+                      const gsl_matrix_float *A, gsl_matrix_float *B) {
+  gsl_blas_strsm(side, uplo, trans, diag, alpha, A, B);
+}
+
+// Cholesky factorization A = L * L^T and solution of L * L^T * x = b in
+// place. Only the lower triangle of A is referenced by the LAPACK versions.
+// Since GSL matrices are row-major, the lower triangle of A is the upper
+// triangle of the column-major matrix seen by LAPACK, for which ?potrf
+// computes A = U^T * U with U = L^T.
+#ifdef SOLVER_LAPACK
+template <typename T>
+inline int lapack_potrf(T *A, size_t n, size_t tda,
+                       void (*potrf)(const char *, const int *, T *,
+                                     const int *, int *)) {
+  int n_ = static_cast<int>(n);
+  int lda = static_cast<int>(tda);
+  int info;
+  potrf("U", &n_, A, &lda, &info);
+  return info == 0 ? GSL_SUCCESS : GSL_EDOM;
+}
+
+template <typename T>
+inline int lapack_potrs(const T *L, size_t n, size_t tda, T *x,
+                       void (*potrs)(const char *, const int *, const int *,
+                                     const T *, const int *, T *, const int *,
+                                     int *)) {
+  int n_ = static_cast<int>(n);
+  int lda = static_cast<int>(tda);
+  int nrhs = 1;
+  int info;
+  potrs("U", &n_, &nrhs, L, &lda, x, &n_, &info);
+  return info == 0 ? GSL_SUCCESS : GSL_EINVAL;
+}
+
+inline int linalg_cholesky_decomp(gsl_matrix *A) {
+  return lapack_potrf(A->data, A->size1, A->tda, dpotrf_);
+}
+
+inline int linalg_cholesky_decomp(gsl_matrix_float *A) {
+  return lapack_potrf(A->data, A->size1, A->tda, spotrf_);
+}
+
+// ?potrs requires x to be contiguous.
+inline int linalg_cholesky_svx(const gsl_matrix *L, gsl_vector *x) {
+  if (x->stride != 1) {
+    gsl_blas_dtrsv(CblasLower, CblasNoTrans, CblasNonUnit, L, x);
+    gsl_blas_dtrsv(CblasLower, CblasTrans, CblasNonUnit, L, x);
+    return GSL_SUCCESS;
+  }
+  return lapack_potrs(L->data, L->size1, L->tda, x->data, dpotrs_);
+}
+
+inline int linalg_cholesky_svx(const gsl_matrix_float *L,
+                               gsl_vector_float *x) {
+  if (x->stride != 1) {
+    gsl_blas_strsv(CblasLower, CblasNoTrans, CblasNonUnit, L, x);
+    gsl_blas_strsv(CblasLower, CblasTrans, CblasNonUnit, L, x);
+    return GSL_SUCCESS;
+  }
+  return lapack_potrs(L->data, L->size1, L->tda, x->data, spotrs_);
+}
+#else
+// GSL only provides the double precision version, so the lower triangle of
+// a float matrix is factored column by column here.
+inline int linalg_cholesky_decomp(gsl_matrix *A) {
+  return gsl_linalg_cholesky_decomp(A);
+}
+
+inline int linalg_cholesky_decomp(gsl_matrix_float *A) {
+  size_t n = A->size1;
+  for (size_t j = 0; j < n; ++j) {
+    gsl_vector_float_view row_j = gsl_matrix_float_row(A, j);
+    float l_jj = gsl_matrix_float_get(A, j, j);
+    if (j > 0) {
+      gsl_vector_float_view l_j =
+          gsl_vector_float_subvector(&row_j.vector, 0, j);
+      float dot;
+      gsl_blas_sdot(&l_j.vector, &l_j.vector, &dot);
+      l_jj -= dot;
+    }
+    if (l_jj <= 0.f)
+      return GSL_EDOM;
+    l_jj = std::sqrt(l_jj);
+    gsl_matrix_float_set(A, j, j, l_jj);
+    if (j + 1 < n) {
+      gsl_vector_float_view col_j = gsl_matrix_float_column(A, j);
+      gsl_vector_float_view l_col =
+          gsl_vector_float_subvector(&col_j.vector, j + 1, n - j - 1);
+      if (j > 0) {
+        gsl_vector_float_view l_j =
+            gsl_vector_float_subvector(&row_j.vector, 0, j);
+        gsl_matrix_float_view L21 =
+            gsl_matrix_float_submatrix(A, j + 1, 0, n - j - 1, j);
+        gsl_blas_sgemv(CblasNoTrans, -1.f, &L21.matrix, &l_j.vector, 1.f,
+                       &l_col.vector);
+      }
+      gsl_vector_float_scale(&l_col.vector, 1.f / l_jj);
+    }
+  }
+  return GSL_SUCCESS;
+}
+
+inline int linalg_cholesky_svx(const gsl_matrix *L, gsl_vector *x) {
+  return gsl_linalg_cholesky_svx(L, x);
+}
+
+inline int linalg_cholesky_svx(const gsl_matrix_float *L,
+                               gsl_vector_float *x) {
+  gsl_blas_strsv(CblasLower, CblasNoTrans, CblasNonUnit, L, x);
+  gsl_blas_strsv(CblasLower, CblasTrans, CblasNonUnit, L, x);
+  return GSL_SUCCESS;
+}
+#endif  // SOLVER_LAPACK
+
+}  // namespace gsl
+
+#endif /* GSL_WRAP_HPP_ */
@@ -186,9 +186,65 @@ void SolverWrap(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     err = PopulateFunctionObj("g", prhs[2], n, &admm_data.g);
 
   if (err == 0)
-    Solver(&admm_data);
+    err = Solver(&admm_data);
 
   delete [] A;
+  if (err != 0)
+    mexErrMsgIdAndTxt("MATLAB:solver:solverFailed", "Solver failed.");
+}
+
+// Wrapper for graph solver with sparse A. Matlab stores sparse matrices in
+// compressed sparse column format, which is converted to compressed sparse
+// row format.
+void SparseSolverWrap(int nlhs, mxArray *plhs[], int nrhs,
+                      const mxArray *prhs[]) {
+  size_t m = mxGetM(prhs[0]);
+  size_t n = mxGetN(prhs[0]);
+  const mwIndex *jc = mxGetJc(prhs[0]);
+  const mwIndex *ir = mxGetIr(prhs[0]);
+  const double *pr = mxGetPr(prhs[0]);
+  size_t nnz = jc[n];
+
+  int *row_ptr = new int[m + 1]();
+  int *col_ind = new int[nnz];
+  double *val = new double[nnz];
+  for (size_t k = 0; k < nnz; ++k)
+    row_ptr[ir[k] + 1]++;
+  for (size_t i = 0; i < m; ++i)
+    row_ptr[i + 1] += row_ptr[i];
+  for (size_t j = 0; j < n; ++j) {
+    for (mwIndex k = jc[j]; k < jc[j + 1]; ++k) {
+      int dest = row_ptr[ir[k]]++;
+      col_ind[dest] = static_cast<int>(j);
+      val[dest] = pr[k];
+    }
+  }
+  for (size_t i = m; i > 0; --i)
+    row_ptr[i] = row_ptr[i - 1];
+  row_ptr[0] = 0;
+
+  AdmmData<double, CsrMatrix<double> > admm_data(
+      CsrMatrix<double>(val, col_ind, row_ptr), m, n);
+  admm_data.f.reserve(m);
+  admm_data.g.reserve(n);
+  admm_data.x = mxGetPr(plhs[0]);
+  if (nlhs == 2)
+    admm_data.y = mxGetPr(plhs[1]);
+
+  int err = PopulateFunctionObj("f", prhs[1], m, &admm_data.f);
+  if (err == 0)
+    err = PopulateFunctionObj("g", prhs[2], n, &admm_data.g);
+
+  if (err == 0)
+    err = Solver(&admm_data);
+
+  delete [] row_ptr;
+  delete [] col_ind;
+  delete [] val;
+  if (err != 0)
+    mexErrMsgIdAndTxt("MATLAB:solver:solverFailed",
+        "Solver failed. The LDL^T factorization of [I A'; A -I] may have "
+        "met a zero pivot.");
 }
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
@@ -228,13 +284,13 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
   if (nlhs == 2)
     plhs[1] = mxCreateNumericMatrix(mxGetM(prhs[0]), 1, class_id_A, mxREAL);
 
-  if (class_id_A == mxDOUBLE_CLASS) {
+  // Matlab only supports sparse matrices in double precision.
+  if (mxIsSparse(prhs[0])) {
+    SparseSolverWrap(nlhs, plhs, nrhs, prhs);
+  } else if (class_id_A == mxDOUBLE_CLASS) {
     SolverWrap<double>(nlhs, plhs, nrhs, prhs);
   } else if (class_id_A == mxSINGLE_CLASS) {
-    //SolverWrap<float>(nlhs, plhs, nrhs, prhs);
-    mexErrMsgIdAndTxt("MATLAB:solver:inputNotStruct",
-        "Function g must be a struct.");
-
+    SolverWrap<float>(nlhs, plhs, nrhs, prhs);
   }
 }
 
@@ -8,11 +8,11 @@ cuda_bin = '/usr/local/cuda/bin';
 cuda_lib = '/usr/local/cuda/lib';
 
 if nargin == 0 || ~strcmp(platform, 'gpu')
-  unix(sprintf('make solver.o -f Makefile -C .. IFLAGS=-D__MEX__'));
+  unix(sprintf('make solver.o ldl.o -f Makefile -C .. IFLAGS=-D__MEX__'));
   mex('-largeArrayDims', ...
       '-I..', ['-I' gsl_path], ...
       '-lgsl', '-lm', ['-L' gsl_lib],...
-      '../solver.o', 'solver_mex.cpp');
+      '../solver.o', '../ldl.o', 'solver_mex.cpp');
 else
   unix(sprintf(['export PATH=$PATH:%s;' ...
                 'export DYLD_LIBRARY_PATH=%s:$DYLD_LIBRARY_PATH;' ...
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "ldl.hpp"
+
+// Implementation of the up-looking sparse LDL^T factorization described in
+//
+//   Algorithm 849: A concise sparse Cholesky factorization package
+//     -- T. A. Davis
+//
+// combined with an approximate minimum degree ordering.
+
+namespace {
+// Computes an approximate minimum degree ordering of the graph of K. The
+// elimination graph is represented implicitly as a quotient graph, where
+// each eliminated node becomes an element whose variables form a clique.
+// Degrees are approximated by
+//
+//   d_i = |A_i| + sum_{e in E_i} |L_e \ L_p|,
+//
+// as in the AMD algorithm, where A_i and E_i are the variables and elements
+// adjacent to i, L_e are the variables of element e and p is the most
+// recently eliminated node.
+void MinDegreeOrder(int n, const int *Kp, const int *Ki,
+                    std::vector<int> *perm) {
+  enum { kVariable, kElement, kAbsorbed };
+  std::vector<std::vector<int> > var_adj(n), elem_adj(n), elem_vars(n);
+  for (int j = 0; j < n; ++j) {
+    for (int p = Kp[j]; p < Kp[j + 1]; ++p) {
+      if (Ki[p] != j) {
+        var_adj[j].push_back(Ki[p]);
+        var_adj[Ki[p]].push_back(j);
+      }
+    }
+  }
+  for (int j = 0; j < n; ++j) {
+    std::sort(var_adj[j].begin(), var_adj[j].end());
+    var_adj[j].erase(std::unique(var_adj[j].begin(), var_adj[j].end()),
+                     var_adj[j].end());
+  }
+
+  std::vector<int> status(n, kVariable), degree(n), mark(n, -1), w(n, -1);
+  std::set<std::pair<int, int> > queue;
+  for (int j = 0; j < n; ++j) {
+    degree[j] = static_cast<int>(var_adj[j].size());
+    queue.insert(std::make_pair(degree[j], j));
+  }
+
+  perm->clear();
+  perm->reserve(n);
+  for (int k = 0; k < n; ++k) {
+    int p = queue.begin()->second;
+    queue.erase(queue.begin());
+    perm->push_back(p);
+
+    // Form the new element L_p from the variables adjacent to p and the
+    // variables of the elements adjacent to p, which are absorbed into p.
+    std::vector<int> &Lp = elem_vars[p];
+    mark[p] = k;
+    for (unsigned int q = 0; q < var_adj[p].size(); ++q) {
+      int v = var_adj[p][q];
+      if (status[v] == kVariable && mark[v] != k) {
+        mark[v] = k;
+        Lp.push_back(v);
+      }
+    }
+    for (unsigned int q = 0; q < elem_adj[p].size(); ++q) {
+      int e = elem_adj[p][q];
+      if (status[e] != kElement)
+        continue;
+      for (unsigned int r = 0; r < elem_vars[e].size(); ++r) {
+        int v = elem_vars[e][r];
+        if (status[v] == kVariable && mark[v] != k) {
+          mark[v] = k;
+          Lp.push_back(v);
+        }
+      }
+      status[e] = kAbsorbed;
+      std::vector<int>().swap(elem_vars[e]);
+    }
+    status[p] = kElement;
+    std::vector<int>().swap(var_adj[p]);
+    std::vector<int>().swap(elem_adj[p]);
+
+    // Compute w[e] = |L_e \ L_p| for all elements e adjacent to L_p.
+    for (unsigned int q = 0; q < Lp.size(); ++q) {
+      int i = Lp[q];
+      for (unsigned int r = 0; r < elem_adj[i].size(); ++r) {
+        int e = elem_adj[i][r];
+        if (status[e] != kElement)
+          continue;
+        if (w[e] < 0 || mark[e] != k) {
+          w[e] = static_cast<int>(elem_vars[e].size());
+          mark[e] = k;
+        }
+        w[e]--;
+      }
+    }
+
+    // Update adjacency and approximate degree of each variable in L_p.
+    // Variables in L_p are removed from A_i, since element p covers them.
+    int num_left = n - k - 1;
+    for (unsigned int q = 0; q < Lp.size(); ++q) {
+      int i = Lp[q];
+      queue.erase(std::make_pair(degree[i], i));
+      std::vector<int> &Ei = elem_adj[i];
+      std::vector<int> &Ai = var_adj[i];
+      int deg = static_cast<int>(Lp.size()) - 1;
+      unsigned int len = 0;
+      for (unsigned int r = 0; r < Ei.size(); ++r) {
+        if (status[Ei[r]] == kElement) {
+          deg += w[Ei[r]];
+          Ei[len++] = Ei[r];
+        }
+      }
+      Ei.resize(len);
+      Ei.push_back(p);
+      len = 0;
+      for (unsigned int r = 0; r < Ai.size(); ++r) {
+        if (status[Ai[r]] == kVariable && mark[Ai[r]] != k)
+          Ai[len++] = Ai[r];
+      }
+      Ai.resize(len);
+      deg += static_cast<int>(len);
+      degree[i] = std::min(deg, num_left - 1);
+      queue.insert(std::make_pair(degree[i], i));
+    }
+  }
+}
+}  // namespace
+
+void LdlSymbolic(int n, const int *Kp, const int *Ki, LdlFactor *ldl) {
+  ldl->n = n;
+  MinDegreeOrder(n, Kp, Ki, &ldl->perm);
+  ldl->perm_inv.resize(n);
+  for (int k = 0; k < n; ++k)
+    ldl->perm_inv[ldl->perm[k]] = k;
+
+  // Compute elimination tree and column counts of L.
+  ldl->parent.assign(n, -1);
+  ldl->Lnz.assign(n, 0);
+  ldl->flag.assign(n, -1);
+  for (int k = 0; k < n; ++k) {
+    ldl->flag[k] = k;
+    int kk = ldl->perm[k];
+    for (int p = Kp[kk]; p < Kp[kk + 1]; ++p) {
+      int i = ldl->perm_inv[Ki[p]];
+      if (i < k) {
+        for (; ldl->flag[i] != k; i = ldl->parent[i]) {
+          if (ldl->parent[i] == -1)
+            ldl->parent[i] = k;
+          ldl->Lnz[i]++;
+          ldl->flag[i] = k;
+        }
+      }
+    }
+  }
+
+  ldl->Lp.resize(n + 1);
+  ldl->Lp[0] = 0;
+  for (int k = 0; k < n; ++k)
+    ldl->Lp[k + 1] = ldl->Lp[k] + ldl->Lnz[k];
+  ldl->Li.resize(ldl->Lp[n]);
+  ldl->Lx.resize(ldl->Lp[n]);
+  ldl->D.resize(n);
+  ldl->y.assign(n, 0.0);
+  ldl->pattern.resize(n);
+}
+
+int LdlNumeric(const int *Kp, const int *Ki, const double *Kx,
+               LdlFactor *ldl) {
+  int n = ldl->n;
+  int *Lp = ldl->Lp.data();
+  int *Li = ldl->Li.data();
+  double *Lx = ldl->Lx.data();
+  double *D = ldl->D.data();
+  double *Y = ldl->y.data();
+  int *parent = ldl->parent.data();
+  int *Lnz = ldl->Lnz.data();
+  int *flag = ldl->flag.data();
+  int *pattern = ldl->pattern.data();
+
+  for (int k = 0; k < n; ++k) {
+    // Compute nonzero pattern of the k'th row of L, in topological order.
+    Y[k] = 0.0;
+    int top = n;
+    flag[k] = k;
+    Lnz[k] = 0;
+    int kk = ldl->perm[k];
+    for (int p = Kp[kk]; p < Kp[kk + 1]; ++p) {
+      int i = ldl->perm_inv[Ki[p]];
+      if (i <= k) {
+        Y[i] += Kx[p];
+        int len;
+        for (len = 0; flag[i] != k; i = parent[i]) {
+          pattern[len++] = i;
+          flag[i] = k;
+        }
+        while (len > 0)
+          pattern[--top] = pattern[--len];
+      }
+    }
+
+    // Compute numerical values of the k'th row of L (a sparse triangular
+    // solve).
+    D[k] = Y[k];
+    Y[k] = 0.0;
+    for (; top < n; ++top) {
+      int i = pattern[top];
+      double yi = Y[i];
+      Y[i] = 0.0;
+      int p2 = Lp[i] + Lnz[i];
+      for (int p = Lp[i]; p < p2; ++p)
+        Y[Li[p]] -= Lx[p] * yi;
+      double l_ki = yi / D[i];
+      D[k] -= l_ki * yi;
+      Li[p2] = k;
+      Lx[p2] = l_ki;
+      Lnz[i]++;
+    }
+    if (D[k] == 0.0)
+      return k + 1;
+  }
+  return 0;
+}
+
+void LdlSolve(const LdlFactor &ldl, double *x, double *work) {
+  int n = ldl.n;
+  for (int k = 0; k < n; ++k)
+    work[k] = x[ldl.perm[k]];
+
+  // Solve L * y = b.
+  for (int j = 0; j < n; ++j)
+    for (int p = ldl.Lp[j]; p < ldl.Lp[j + 1]; ++p)
+      work[ldl.Li[p]] -= ldl.Lx[p] * work[j];
+
+  // Solve D * y = y.
+  for (int j = 0; j < n; ++j)
+    work[j] /= ldl.D[j];
+
+  // Solve L^T * x = y.
+  for (int j = n - 1; j >= 0; --j)
+    for (int p = ldl.Lp[j]; p < ldl.Lp[j + 1]; ++p)
+      work[j] -= ldl.Lx[p] * work[ldl.Li[p]];
+
+  for (int k = 0; k < n; ++k)
+    x[ldl.perm[k]] = work[k];
+}
+
@@ -0,0 +1,42 @@
+#ifndef LDL_HPP_
+#define LDL_HPP_
+
+#include <vector>
+
+// Sparse LDL^T factorization of a symmetric (quasi-definite) matrix K, where
+// P * K * P^T = L * D * L^T for a fill-reducing permutation P, unit lower
+// triangular L and diagonal D. Quasi-definite matrices (such as the KKT
+// matrix [I A^T; A -I]) can be factored for any permutation.
+struct LdlFactor {
+  int n;
+
+  // Permutation (perm[k] is the k'th row/column of K to be eliminated) and
+  // its inverse.
+  std::vector<int> perm, perm_inv;
+
+  // L in compressed sparse column format and D.
+  std::vector<int> Lp, Li;
+  std::vector<double> Lx, D;
+
+  // Elimination tree and workspace for the numeric factorization.
+  std::vector<int> parent, Lnz, flag, pattern;
+  std::vector<double> y;
+};
+
+// Computes a minimum degree ordering and the symbolic factorization of K.
+// K is an n x n matrix in compressed sparse column format (Kp, Ki) with both
+// triangles stored.
+void LdlSymbolic(int n, const int *Kp, const int *Ki, LdlFactor *ldl);
+
+// Computes the numeric factorization of K, which must have the same sparsity
+// pattern as the matrix passed to LdlSymbolic(). Returns 0 on success and
+// k + 1 if the k'th pivot is zero.
+int LdlNumeric(const int *Kp, const int *Ki, const double *Kx,
+               LdlFactor *ldl);
+
+// Solves K * x = b in place, where x holds b on entry. work must have
+// length n.
+void LdlSolve(const LdlFactor &ldl, double *x, double *work);
+
+#endif /* LDL_HPP_ */
+
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <random>
 #include <vector>
 
@@ -248,17 +250,260 @@ real_t test5(size_t m, size_t n) {
 
   real_t lambda = static_cast<real_t>(2e-2 + 5e-6 * static_cast<real_t>(m));
 
+  // All elements of f share a = c = 1 and d = 0, and all elements of g are
+  // the same, so only b needs to be stored per element.
+  admm_data.f_vec = FunctionVec<real_t>(m, FunctionObj<real_t>(kSquare));
+  admm_data.f_vec.b.assign(b.begin(), b.end());
+  admm_data.g_vec = FunctionVec<real_t>(n, FunctionObj<real_t>(kAbs, lambda));
+
+  double t = timer();
+  Solver(&admm_data);
+  printf("%lu, %e\n", m, timer() - t);
+
+  return 0;
+}
+
+// Sparse Lasso
+//   minimize    (1/2) ||Ax - b||_2^2 + \lambda ||x||_1,
+//
+// where A has about 5% nonzeros. The problem is solved once with A in CSR
+// format (LDL^T factorization of the KKT matrix) and once with A stored
+// densely (Cholesky factorization), and the two solutions are compared.
+real_t test6() {
+  printf("\nSparse Lasso.\n");
+  size_t m = 1000;
+  size_t n = 200;
+  std::vector<real_t> A(m * n);
+  std::vector<real_t> val;
+  std::vector<int> col_ind;
+  std::vector<int> row_ptr(1, 0);
+  std::vector<real_t> x(n), x_dense(n);
+  std::vector<real_t> y(m), y_dense(m);
+
+  std::default_random_engine generator;
+  std::uniform_real_distribution<real_t> u_dist(static_cast<real_t>(0),
+                                                static_cast<real_t>(1));
+  std::normal_distribution<real_t> n_dist(static_cast<real_t>(0),
+                                          static_cast<real_t>(1));
+
+  for (unsigned int i = 0; i < m; ++i) {
+    for (unsigned int j = 0; j < n; ++j) {
+      if (u_dist(generator) < 0.05) {
+        A[i * n + j] = n_dist(generator);
+        val.push_back(A[i * n + j]);
+        col_ind.push_back(static_cast<int>(j));
+      }
+    }
+    row_ptr.push_back(static_cast<int>(val.size()));
+  }
+
+  std::vector<real_t> x_true(n);
+  for (unsigned int i = 0; i < n; ++i)
+    x_true[i] = u_dist(generator) < 0.8 ? 0 : n_dist(generator);
+
+  AdmmData<real_t, CsrMatrix<real_t> > admm_data(
+      CsrMatrix<real_t>(val.data(), col_ind.data(), row_ptr.data()), m, n);
+  admm_data.x = x.data();
+  admm_data.y = y.data();
+
+  real_t lambda = static_cast<real_t>(1);
+
   admm_data.f.reserve(m);
-  for (unsigned int i = 0; i < m; ++i)
-    admm_data.f.emplace_back(kSquare, static_cast<real_t>(1), b[i]);
+  for (unsigned int i = 0; i < m; ++i) {
+    real_t b_i = static_cast<real_t>(0.1) * n_dist(generator);
+    for (unsigned int j = 0; j < n; ++j)
+      b_i += A[i * n + j] * x_true[j];
+    admm_data.f.emplace_back(kSquare, static_cast<real_t>(1), b_i);
+  }
+
+  admm_data.g.reserve(n);
+  for (unsigned int i = 0; i < n; ++i)
+    admm_data.g.emplace_back(kAbs, lambda);
+
+  AdmmData<real_t, real_t*> dense_data(A.data(), m, n);
+  dense_data.x = x_dense.data();
+  dense_data.y = y_dense.data();
+  dense_data.f = admm_data.f;
+  dense_data.g = admm_data.g;
+
+  if (Solver(&admm_data) != 0 || Solver(&dense_data) != 0)
+    return 1;
+
+  real_t max_diff = static_cast<real_t>(0);
+  for (unsigned int i = 0; i < n; ++i)
+    max_diff = std::max(max_diff, std::abs(x[i] - x_dense[i]));
+  printf("max |x_sparse - x_dense| = %.3e\n", max_diff);
+
+  return 0;
+}
+
+// Lasso by Row Blocks
+//   minimize    (1/2) ||Ax - b||_2^2 + \lambda ||x||_1
+//
+// The problem is solved with Solver() and with SolverBlocks() on 2 and 4
+// blocks of rows, all at the default tolerances, and the objectives at the
+// returned x are compared (0 blocks stands for Solver()).
+real_t test7() {
+  printf("\nLasso by Row Blocks.\n");
+  size_t m = 1000;
+  size_t n = 100;
+  std::vector<real_t> A(m * n);
+  std::vector<real_t> b(m);
+  std::vector<real_t> x(n);
+  std::vector<real_t> y(m);
+
+  std::default_random_engine generator;
+  std::uniform_real_distribution<real_t> u_dist(static_cast<real_t>(0),
+                                                static_cast<real_t>(1));
+  std::normal_distribution<real_t> n_dist(static_cast<real_t>(0),
+                                          static_cast<real_t>(1));
+
+  for (unsigned int i = 0; i < m * n; ++i)
+    A[i] = 1 / static_cast<real_t>(n) * n_dist(generator);
+
+  std::vector<real_t> x_true(n);
+  for (unsigned int i = 0; i < n; ++i)
+    x_true[i] = u_dist(generator) < 0.8 ? 0 : n_dist(generator);
+
+  for (unsigned int i = 0; i < m; ++i) {
+    for (unsigned int j = 0; j < n; ++j)
+      b[i] += A[i * n + j] * x_true[j];
+    b[i] += static_cast<real_t>(0.5) * n_dist(generator);
+  }
+
+  real_t lambda = static_cast<real_t>(2e-2);
+
+  unsigned int num_blocks[] = { 0, 2, 4 };
+  for (unsigned int k = 0; k < 3; ++k) {
+    AdmmData<real_t, real_t*> admm_data(A.data(), m, n);
+    admm_data.x = x.data();
+    admm_data.y = y.data();
+    admm_data.quiet = true;
+
+    admm_data.f.reserve(m);
+    for (unsigned int i = 0; i < m; ++i)
+      admm_data.f.emplace_back(kSquare, static_cast<real_t>(1), b[i]);
+
+    admm_data.g.reserve(n);
+    for (unsigned int i = 0; i < n; ++i)
+      admm_data.g.emplace_back(kAbs, lambda);
+
+    int err = num_blocks[k] == 0 ? Solver(&admm_data) :
+        SolverBlocks(&admm_data, num_blocks[k]);
+    if (err != 0)
+      return 1;
+
+    real_t obj = static_cast<real_t>(0);
+    for (unsigned int i = 0; i < m; ++i) {
+      real_t r_i = -b[i];
+      for (unsigned int j = 0; j < n; ++j)
+        r_i += A[i * n + j] * x[j];
+      obj += r_i * r_i / 2;
+    }
+    for (unsigned int j = 0; j < n; ++j)
+      obj += lambda * std::abs(x[j]);
+    printf("blocks = %u, objective = %.6e\n", num_blocks[k], obj);
+  }
+
+  return 0;
+}
+
+// Logistic Regression
+//   minimize    sum_i log(1 + exp(a_i^T x)) - y_i a_i^T x + \lambda ||x||_1,
+//
+// where y_i in {0, 1} are the labels.
+real_t test8() {
+  printf("\nLogistic Regression.\n");
+  size_t m = 1000;
+  size_t n = 100;
+  std::vector<real_t> A(m * n);
+  std::vector<real_t> x(n);
+  std::vector<real_t> y(m);
+
+  std::default_random_engine generator;
+  std::uniform_real_distribution<real_t> u_dist(static_cast<real_t>(0),
+                                                static_cast<real_t>(1));
+  std::normal_distribution<real_t> n_dist(static_cast<real_t>(0),
+                                          static_cast<real_t>(1));
+
+  for (unsigned int i = 0; i < m * n; ++i)
+    A[i] = n_dist(generator);
+
+  // Draw the labels from the logistic model with a sparse x_true.
+  std::vector<real_t> x_true(n);
+  for (unsigned int i = 0; i < n; ++i)
+    x_true[i] = u_dist(generator) < 0.8 ? 0 : n_dist(generator);
+
+  AdmmData<real_t, real_t*> admm_data(A.data(), m, n);
+  admm_data.x = x.data();
+  admm_data.y = y.data();
+
+  real_t lambda = static_cast<real_t>(5);
+
+  admm_data.f.reserve(m);
+  for (unsigned int i = 0; i < m; ++i) {
+    real_t z_i = static_cast<real_t>(0);
+    for (unsigned int j = 0; j < n; ++j)
+      z_i += A[i * n + j] * x_true[j];
+    real_t label = u_dist(generator) < 1 / (1 + std::exp(-z_i)) ?
+        static_cast<real_t>(1) : static_cast<real_t>(0);
+    admm_data.f.emplace_back(kLogistic, static_cast<real_t>(1),
+                             static_cast<real_t>(0), static_cast<real_t>(1),
+                             -label);
+  }
 
   admm_data.g.reserve(n);
   for (unsigned int i = 0; i < n; ++i)
     admm_data.g.emplace_back(kAbs, lambda);
 
-  double t = timer();
   Solver(&admm_data);
-  printf("%lu, %e\n", m, timer() - t);
+
+  return 0;
+}
+
+// Huber Fitting
+//   minimize    sum_i huber(a_i^T x - b_i).
+real_t test9() {
+  printf("\nHuber Fitting.\n");
+  size_t m = 1000;
+  size_t n = 100;
+  std::vector<real_t> A(m * n);
+  std::vector<real_t> x(n);
+  std::vector<real_t> y(m);
+
+  std::default_random_engine generator;
+  std::uniform_real_distribution<real_t> u_dist(static_cast<real_t>(0),
+                                                static_cast<real_t>(1));
+  std::normal_distribution<real_t> n_dist(static_cast<real_t>(0),
+                                          static_cast<real_t>(1));
+
+  for (unsigned int i = 0; i < m * n; ++i)
+    A[i] = 1 / static_cast<real_t>(n) * n_dist(generator);
+
+  std::vector<real_t> x_true(n);
+  for (unsigned int i = 0; i < n; ++i)
+    x_true[i] = n_dist(generator);
+
+  AdmmData<real_t, real_t*> admm_data(A.data(), m, n);
+  admm_data.x = x.data();
+  admm_data.y = y.data();
+
+  // Generate b = A * x_true + noise, where 5% of the entries are outliers.
+  admm_data.f.reserve(m);
+  for (unsigned int i = 0; i < m; ++i) {
+    real_t b_i = static_cast<real_t>(0);
+    for (unsigned int j = 0; j < n; ++j)
+      b_i += A[i * n + j] * x_true[j];
+    b_i += u_dist(generator) < 0.05 ? 10 * n_dist(generator) :
+        static_cast<real_t>(0.1) * n_dist(generator);
+    admm_data.f.emplace_back(kHuber, static_cast<real_t>(1), b_i);
+  }
+
+  admm_data.g.reserve(n);
+  for (unsigned int i = 0; i < n; ++i)
+    admm_data.g.emplace_back(kZero);
+
+  Solver(&admm_data);
 
   return 0;
 }
@@ -268,6 +513,10 @@ int main() {
   // test2();
   // test3();
   // test4();
+  // test6();
+  // test7();
+  // test8();
+  // test9();
   size_t dim[] = {
       600, 743, 921, 1141, 1413, 1751, 2170, 2689, 3331, 4128, 5114,
       6337, 7851, 9728, 12053, 14933, 18502, 22924, 28403, 35191, 43602,
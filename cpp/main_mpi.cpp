@@ -0,0 +1,76 @@
+#include <random>
+#include <vector>
+
+#include "solver.hpp"
+#include "timer.hpp"
+
+typedef double real_t;
+
+// Lasso, split by rows across the MPI processes.
+//   minimize    (1/2) ||Ax - b||_2^2 + \lambda ||x||_1
+//
+// Each process generates and factors only its own block of m / N rows of A,
+// where N is the number of processes. Run with e.g. `mpirun -np 4 ./main_mpi`.
+real_t test_lasso(size_t m, size_t n) {
+  int rank, num_procs;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+  size_t row_begin = m * rank / num_procs;
+  size_t m_block = m * (rank + 1) / num_procs - row_begin;
+  if (rank == 0)
+    printf("\nLasso on %d processes.\n", num_procs);
+
+  std::vector<real_t> A(m_block * n);
+  std::vector<real_t> b(m_block);
+  std::vector<real_t> x(n);
+  std::vector<real_t> y(m_block);
+
+  // x_true is the same on all processes, while A and the noise differ.
+  std::default_random_engine generator;
+  std::uniform_real_distribution<real_t> u_dist(static_cast<real_t>(0),
+                                                static_cast<real_t>(1));
+  std::normal_distribution<real_t> n_dist(static_cast<real_t>(0),
+                                          static_cast<real_t>(1));
+
+  std::vector<real_t> x_true(n);
+  for (unsigned int i = 0; i < n; ++i)
+    x_true[i] = u_dist(generator) < 0.8 ? 0 : n_dist(generator);
+
+  generator.seed(static_cast<unsigned int>(rank + 1));
+  for (unsigned int i = 0; i < m_block * n; ++i)
+    A[i] = 1 / static_cast<real_t>(n) * n_dist(generator);
+
+  for (unsigned int i = 0; i < m_block; ++i) {
+    for (unsigned int j = 0; j < n; ++j)
+      b[i] += A[i * n + j] * x_true[j];
+    b[i] += 0.5 * n_dist(generator);
+  }
+
+  AdmmData<real_t, real_t*> admm_data(A.data(), m_block, n);
+  admm_data.x = x.data();
+  admm_data.y = y.data();
+  admm_data.adaptive_rho = true;
+
+  real_t lambda = static_cast<real_t>(2e-2 + 5e-6 * static_cast<real_t>(m));
+
+  admm_data.f.reserve(m_block);
+  for (unsigned int i = 0; i < m_block; ++i)
+    admm_data.f.emplace_back(kSquare, static_cast<real_t>(1), b[i]);
+
+  admm_data.g.reserve(n);
+  for (unsigned int i = 0; i < n; ++i)
+    admm_data.g.emplace_back(kAbs, lambda);
+
+  double t = timer();
+  SolverMpi(&admm_data, MPI_COMM_WORLD);
+  if (rank == 0)
+    printf("%lu, %e\n", m, timer() - t);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  test_lasso(100000, 500);
+  MPI_Finalize();
+}
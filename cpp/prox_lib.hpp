@@ -1,9 +1,13 @@
 #ifndef PROX_LIB_HPP_
 #define PROX_LIB_HPP_
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
+#include <new>
 #include <vector>
 
 #ifdef __CUDACC__
@@ -17,6 +21,12 @@
 #define __DEVICE__
 #endif
 
+// Loops over fewer than SOLVER_OMP_MIN_LEN function objects run serially,
+// since the cost of starting a parallel region would exceed the gain.
+#ifndef SOLVER_OMP_MIN_LEN
+#define SOLVER_OMP_MIN_LEN 8192
+#endif
+
 // List of functions supported by the proximal operator library.
 enum Function { kAbs,       // f(x) = |x|
                 kHuber,     // f(x) = huber(x)
@@ -65,17 +75,125 @@ struct FunctionObj {
 
 // Local Functions.
 namespace {
-// Evalution of max(0, x).
+// Evalution of max(0, x). Written as a comparison rather than with fmax(),
+// which the compiler cannot vectorize without -ffast-math.
 template <typename T>
 __DEVICE__ inline T MaxPos(T x) {
-  return fmax(static_cast<T>(0), x);
+  return x > static_cast<T>(0) ? x : static_cast<T>(0);
 }
 
 //  Evalution of max(0, -x).
 template <typename T>
 __DEVICE__ inline T MaxNeg(T x) {
-  return fmax(static_cast<T>(0), -x);
+  return x < static_cast<T>(0) ? -x : static_cast<T>(0);
+}
+
+// Elementary functions, which on the CPU call the float overloads from
+// <cmath> when T = float, as CUDA does on the device.
+template <typename T>
+__DEVICE__ inline T Exp(T x) {
+#ifdef __CUDACC__
+  return exp(x);
+#else
+  return std::exp(x);
+#endif
+}
+
+template <typename T>
+__DEVICE__ inline T Fabs(T x) {
+#ifdef __CUDACC__
+  return fabs(x);
+#else
+  return std::fabs(x);
+#endif
+}
+
+template <typename T>
+__DEVICE__ inline T Log(T x) {
+#ifdef __CUDACC__
+  return log(x);
+#else
+  return std::log(x);
+#endif
+}
+
+template <typename T>
+__DEVICE__ inline T Sqrt(T x) {
+#ifdef __CUDACC__
+  return sqrt(x);
+#else
+  return std::sqrt(x);
+#endif
+}
+
+// Evaluation of exp(x), clamped to the range of normal numbers. On the CPU,
+// exp() from libm is a function call, which prevents the loops over
+// elements from being vectorized. Instead, x = k * log(2) + r is split with
+// the rounding of the shifted product x * log2(e) + 1.5 * 2^p, where p is
+// the number of mantissa bits, such that exp(x) = 2^k * exp(r) with |r| <=
+// log(2) / 2. The factor 2^k is assembled from the exponent bits, and
+// exp(r) is approximated by its Taylor polynomial, which is accurate to
+// within a few units in the last place.
+#ifdef __CUDACC__
+template <typename T>
+__DEVICE__ inline T ProxExp(T x) {
+  return Exp(x);
 }
+#else
+inline double ProxExp(double x) {
+  const double kShift = 6755399441055744.0;  // 1.5 * 2^52
+  x = x < -708.0 ? -708.0 : x > 709.0 ? 709.0 : x;
+  double t = x * 1.4426950408889634 + kShift;
+  double k = t - kShift;
+  double r = x - k * 6.93147180369123816490e-01;
+  r = r - k * 1.90821492927058770002e-10;
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+  long long t_bits, shift_bits;
+  std::memcpy(&t_bits, &t, sizeof(t));
+  std::memcpy(&shift_bits, &kShift, sizeof(kShift));
+  long long scale_bits = (t_bits - shift_bits + 1023) << 52;
+  double scale;
+  std::memcpy(&scale, &scale_bits, sizeof(scale));
+  return p * scale;
+}
+
+inline float ProxExp(float x) {
+  const float kShift = 12582912.0f;  // 1.5 * 2^23
+  x = x < -87.0f ? -87.0f : x > 88.0f ? 88.0f : x;
+  float t = x * 1.44269504f + kShift;
+  float k = t - kShift;
+  float r = x - k * 0.693145752f;
+  r = r - k * 1.42860677e-06f;
+  float p = 1.0f / 5040.0f;
+  p = p * r + 1.0f / 720.0f;
+  p = p * r + 1.0f / 120.0f;
+  p = p * r + 1.0f / 24.0f;
+  p = p * r + 1.0f / 6.0f;
+  p = p * r + 0.5f;
+  p = p * r + 1.0f;
+  p = p * r + 1.0f;
+  int t_bits, shift_bits;
+  std::memcpy(&t_bits, &t, sizeof(t));
+  std::memcpy(&shift_bits, &kShift, sizeof(kShift));
+  int scale_bits = (t_bits - shift_bits + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &scale_bits, sizeof(scale));
+  return p * scale;
+}
+#endif  // __CUDACC__
 }  // namespace
 
 
@@ -99,7 +217,14 @@ __DEVICE__ inline T ProxAbs(T x, T a, T b, T c, T d, T rho) {
 
 template <typename T>
 __DEVICE__ inline T ProxHuber(T x, T a, T b, T c, T d, T rho) {
-  return 0;
+  T x_ = a * (x - d / rho) - b;
+  T rho_ = rho / (c * a * a);
+  T z = rho_ * x_ / (static_cast<T>(1) + rho_);
+  z = x_ >= static_cast<T>(1) + static_cast<T>(1) / rho_
+      ? x_ - static_cast<T>(1) / rho_ : z;
+  z = x_ <= -static_cast<T>(1) - static_cast<T>(1) / rho_
+      ? x_ + static_cast<T>(1) / rho_ : z;
+  return (z + b) / a;
 }
 
 template <typename T>
@@ -112,10 +237,10 @@ __DEVICE__ inline T ProxIdentity(T x, T a, T b, T c, T d, T rho) {
 
 template <typename T>
 __DEVICE__ inline T ProxIndBox01(T x, T a, T b, T c, T d, T rho) {
-  x = x - d / rho;
-  x = a * x <= b ? static_cast<T>(0) : a * x - b;
-  x = a * x >= b + static_cast<T>(1) ? static_cast<T>(1) : a * x - b;
-  return x;
+  T x_ = a * (x - d / rho) - b;
+  T z = x_ <= static_cast<T>(0) ? static_cast<T>(0) :
+      x_ >= static_cast<T>(1) ? static_cast<T>(1) : x_;
+  return (z + b) / a;
 }
 
 template <typename T>
@@ -125,25 +250,56 @@ __DEVICE__ inline T ProxIndEq0(T x, T a, T b, T c, T d, T rho) {
 
 template <typename T>
 __DEVICE__ inline T ProxIndGe0(T x, T a, T b, T c, T d, T rho) {
-  return a * (x - d / rho) <= b ? static_cast<T>(0) : a * (x - d / rho) - b;
+  T x_ = a * (x - d / rho) - b;
+  T z = x_ <= static_cast<T>(0) ? static_cast<T>(0) : x_;
+  return (z + b) / a;
 }
 
 template <typename T>
 __DEVICE__ inline T ProxIndLe0(T x, T a, T b, T c, T d, T rho) {
-  return a * (x - d / rho) >= b ? static_cast<T>(0) : a * (x - d / rho) - b;
+  T x_ = a * (x - d / rho) - b;
+  T z = x_ >= static_cast<T>(0) ? static_cast<T>(0) : x_;
+  return (z + b) / a;
 }
 
 template <typename T>
 __DEVICE__ inline T ProxNegLog(T x, T a, T b, T c, T d, T rho) {
   T x_ = a * (x - d / rho) - b;
   T rho_ = rho / (c * a * a);
-  T z = (x_ + sqrt(x_ * x_ + 4 / rho_)) / 2;
+  T z = (x_ + Sqrt(x_ * x_ + 4 / rho_)) / 2;
   return (z + b) / a;
 }
 
+// The minimizer z of log(1 + e^z) + (rho_ / 2) (z - x_)^2 solves
+// sigma(z) + rho_ (z - x_) = 0, where sigma(z) = 1 / (1 + e^-z), and lies in
+// [x_ - 1 / rho_, x_]. It is found by a fixed number of Newton steps from a
+// piecewise linear guess, where steps that leave the bracket of the root are
+// replaced by bisection. Since the number of steps does not depend on x, the
+// loops over elements can be vectorized once the steps are unrolled. Far to
+// the left of the root, Newton steps shorten the distance to it by about
+// one per step, such that 12 steps reach full precision for rho_ >= 1e-5.
+const unsigned int kProxLogisticIter = 12;
+
 template <typename T>
 __DEVICE__ inline T ProxLogistic(T x, T a, T b, T c, T d, T rho) {
-  return 0;
+  const T kOne = static_cast<T>(1);
+  T x_ = a * (x - d / rho) - b;
+  T rho_ = rho / (c * a * a);
+  T l = x_ - kOne / rho_, u = x_;
+  T z = (rho_ * x_ - static_cast<T>(0.5)) / (static_cast<T>(0.2) + rho_);
+  z = x_ < static_cast<T>(-2.5) ? x_ : z;
+  z = l > static_cast<T>(2.5) ? l : z;
+  #pragma GCC unroll 16
+  for (unsigned int i = 0; i < kProxLogisticIter; ++i) {
+    T s = kOne / (kOne + ProxExp(-z));
+    T g = s + rho_ * (z - x_);
+    l = g < static_cast<T>(0) ? z : l;
+    u = g < static_cast<T>(0) ? u : z;
+    T z_newton = z - g / (s * (kOne - s) + rho_);
+    z = z_newton >= l && z_newton <= u
+        ? z_newton : static_cast<T>(0.5) * (l + u);
+  }
+  return (z + b) / a;
 }
 
 template <typename T>
@@ -179,14 +335,11 @@ __DEVICE__ inline T ProxZero(T x, T a, T b, T c, T d, T rho) {
   return x - d / rho;
 }
 
-// Evaluates the proximal operator of f.
+// Evaluates the proximal operator of c * f(a * x - b) + d * x. If f is a
+// compile-time constant, the switch is resolved when the call is inlined.
 template <typename T>
-__DEVICE__ inline T ProxEval(const FunctionObj<T> &f_obj, T x, T rho) {
-  const T a = f_obj.a;
-  const T b = f_obj.b;
-  const T c = f_obj.c;
-  const T d = f_obj.d;
-  switch (f_obj.f) {
+__DEVICE__ inline T ProxEval(Function f, T x, T a, T b, T c, T d, T rho) {
+  switch (f) {
     case kAbs:
       return ProxAbs(x, a, b, c, d, rho);
     case kHuber:
@@ -216,6 +369,12 @@ __DEVICE__ inline T ProxEval(const FunctionObj<T> &f_obj, T x, T rho) {
   }
 }
 
+// Evaluates the proximal operator of f.
+template <typename T>
+__DEVICE__ inline T ProxEval(const FunctionObj<T> &f_obj, T x, T rho) {
+  return ProxEval(f_obj.f, x, f_obj.a, f_obj.b, f_obj.c, f_obj.d, rho);
+}
+
 
 // Function definitions.
 //
@@ -226,13 +385,15 @@ __DEVICE__ inline T ProxEval(const FunctionObj<T> &f_obj, T x, T rho) {
 //   x -> c * f(a * x - b) + d * x.
 template <typename T>
 __DEVICE__ inline T FuncAbs(T x, T a, T b, T c, T d) {
-  return c * fabs(a * x + b) + d * x;
+  return c * Fabs(a * x + b) + d * x;
 }
 
 template <typename T>
 __DEVICE__ inline T FuncHuber(T x, T a, T b, T c, T d) {
-  T xabs = fabs(a * x - b);
-  return xabs < static_cast<T>(1) ? c * xabs * xabs + d * x : c * xabs + d * x;
+  T xabs = Fabs(a * x - b);
+  T huber = xabs < static_cast<T>(1) ? xabs * xabs / static_cast<T>(2) :
+      xabs - static_cast<T>(0.5);
+  return c * huber + d * x;
 }
 
 template <typename T>
@@ -262,12 +423,13 @@ __DEVICE__ inline T FuncIndLe0(T x, T a, T b, T c, T d) {
 
 template <typename T>
 __DEVICE__ inline T FuncNegLog(T x, T a, T b, T c, T d) {
-  return -c * log(a * x - b) + d * x;
+  return -c * Log(a * x - b) + d * x;
 }
 
 template <typename T>
 __DEVICE__ inline T FuncLogistic(T x, T a, T b, T c, T d) {
-  return c * log(static_cast<T>(1) + exp(a * x + b)) + d * x;
+  T x_ = a * x - b;
+  return c * (MaxPos(x_) + Log(static_cast<T>(1) + Exp(-Fabs(x_)))) + d * x;
 }
 
 template <typename T>
@@ -291,14 +453,10 @@ __DEVICE__ inline T FuncZero(T x, T a, T b, T c, T d) {
   return d * x;
 }
 
-// Evaluates the function f.
+// Evaluates c * f(a * x - b) + d * x.
 template <typename T>
-__DEVICE__ inline T FuncEval(const FunctionObj<T> &f_obj, T x) {
-  const T a = f_obj.a;
-  const T b = f_obj.b;
-  const T c = f_obj.c;
-  const T d = f_obj.d;
-  switch (f_obj.f) {
+__DEVICE__ inline T FuncEval(Function f, T x, T a, T b, T c, T d) {
+  switch (f) {
     case kAbs:
       return FuncAbs(x, a, b, c, d);
     case kHuber:
@@ -328,6 +486,12 @@ __DEVICE__ inline T FuncEval(const FunctionObj<T> &f_obj, T x) {
   }
 }
 
+// Evaluates the function f.
+template <typename T>
+__DEVICE__ inline T FuncEval(const FunctionObj<T> &f_obj, T x) {
+  return FuncEval(f_obj.f, x, f_obj.a, f_obj.b, f_obj.c, f_obj.d);
+}
+
 
 // Evaluates the proximal operator Prox{f_obj[i]}(x_in[i]) -> x_out[i].
 //
@@ -338,7 +502,7 @@ __DEVICE__ inline T FuncEval(const FunctionObj<T> &f_obj, T x) {
 template <typename T>
 void ProxEval(const std::vector<FunctionObj<T> > &f_obj, T rho, const T* x_in,
               T* x_out) {
-  #pragma omp parallel for
+  #pragma omp parallel for if (f_obj.size() >= SOLVER_OMP_MIN_LEN)
   for (unsigned int i = 0; i < f_obj.size(); ++i)
     x_out[i] = ProxEval(f_obj[i], x_in[i], rho);
 }
@@ -353,12 +517,536 @@ void ProxEval(const std::vector<FunctionObj<T> > &f_obj, T rho, const T* x_in,
 template <typename T>
 T FuncEval(const std::vector<FunctionObj<T> > &f_obj, const T* x_in) {
   T sum = 0;
-  #pragma omp parallel for reduction(+:sum)
+  #pragma omp parallel for reduction(+:sum) \
+      if (f_obj.size() >= SOLVER_OMP_MIN_LEN)
   for (unsigned int i = 0; i < f_obj.size(); ++i)
     sum += FuncEval(f_obj[i], x_in[i]);
   return sum;
 }
 
+// Allocator for std::vector that aligns storage to kProxAlign bytes (one
+// cache line), such that vectorized loops over the array start on a cache
+// line boundary.
+const size_t kProxAlign = 64;
+
+template <typename T>
+struct AlignedAllocator {
+  typedef T value_type;
+
+  AlignedAllocator() { }
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U> &) { }
+
+  T *allocate(size_t num) {
+    void *ptr = 0;
+    if (posix_memalign(&ptr, kProxAlign, num * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+  void deallocate(T *ptr, size_t) { free(ptr); }
+};
+
+template <typename T, typename U>
+bool operator==(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {
+  return false;
+}
+
+// Vector of function objects in structure-of-arrays form, which the solver
+// uses in place of std::vector<FunctionObj<T> > to reduce the memory traffic
+// of the proximal step. The parameters a, b, c and d are stored in separate
+// aligned arrays, each of which is left empty if its value is the same for
+// all elements, in which case the value is taken from a_all, b_all, c_all or
+// d_all. For example, the lasso term lambda ||x||_1 needs no arrays at all,
+// and a least squares term only the array b.
+//
+// The function types are stored as runs of equal type, such that the
+// kernels below evaluate each run with a loop in which the type is a
+// compile-time constant, which the compiler can vectorize. If the runs are
+// shorter than kProxMinRun elements on average, the types are instead stored
+// in one byte per element and dispatched per element.
+const unsigned int kProxChunk = 256;
+const unsigned int kProxMinRun = 16;
+
+// Flags for the parameters of a FunctionVec that are the same for all
+// elements.
+enum { kConstA = 1, kConstB = 2, kConstC = 4, kConstD = 8, kConstAll = 15 };
+
+template <typename T>
+struct FunctionVec {
+  typedef std::vector<T, AlignedAllocator<T> > Array;
+
+  size_t size;
+  T a_all, b_all, c_all, d_all;
+  Array a, b, c, d;
+
+  // Run r covers the elements run_begin[r], ..., run_begin[r + 1] - 1 and
+  // has type run_f[r]. Empty if f is not.
+  std::vector<size_t> run_begin;
+  std::vector<unsigned char> run_f;
+  std::vector<unsigned char> f;
+
+  // The values a_all, b_all, c_all and d_all repeated kProxChunk times, which
+  // stand in for the omitted arrays.
+  Array fill;
+
+  FunctionVec() : size(0), a_all(static_cast<T>(1)), b_all(static_cast<T>(0)),
+      c_all(static_cast<T>(1)), d_all(static_cast<T>(0)) { }
+  explicit FunctionVec(const std::vector<FunctionObj<T> > &f_obj) {
+    Assign(f_obj, std::vector<FunctionObj<T> >());
+  }
+  FunctionVec(const std::vector<FunctionObj<T> > &f_obj1,
+              const std::vector<FunctionObj<T> > &f_obj2) {
+    Assign(f_obj1, f_obj2);
+  }
+
+  // Compact form of size copies of f_obj. Parameters that vary can then be
+  // given by filling the corresponding arrays a, b, c or d with size values,
+  // e.g. b for a least squares term. The values a_all, b_all, c_all and d_all
+  // must not be changed directly.
+  FunctionVec(size_t size, const FunctionObj<T> &f_obj)
+      : size(size), a_all(f_obj.a), b_all(f_obj.b), c_all(f_obj.c),
+        d_all(f_obj.d) {
+    std::vector<size_t> runs(1, 0);
+    runs.push_back(size);
+    SetTypes(runs, std::vector<unsigned char>(1,
+        static_cast<unsigned char>(f_obj.f)));
+    SetFill();
+  }
+
+  // Stores the concatenation of f_obj1 and f_obj2.
+  void Assign(const std::vector<FunctionObj<T> > &f_obj1,
+              const std::vector<FunctionObj<T> > &f_obj2) {
+    *this = FunctionVec();
+    size_t size1 = f_obj1.size();
+    size = size1 + f_obj2.size();
+    if (size > 0) {
+      const FunctionObj<T> &h0 = size1 > 0 ? f_obj1[0] : f_obj2[0];
+      a_all = h0.a;
+      b_all = h0.b;
+      c_all = h0.c;
+      d_all = h0.d;
+    }
+    bool a_same = true, b_same = true, c_same = true, d_same = true;
+    std::vector<size_t> runs;
+    std::vector<unsigned char> types;
+    for (unsigned int i = 0; i < size; ++i) {
+      const FunctionObj<T> &h = i < size1 ? f_obj1[i] : f_obj2[i - size1];
+      a_same = a_same && h.a == a_all;
+      b_same = b_same && h.b == b_all;
+      c_same = c_same && h.c == c_all;
+      d_same = d_same && h.d == d_all;
+      if (i == 0 || h.f != types.back()) {
+        runs.push_back(i);
+        types.push_back(static_cast<unsigned char>(h.f));
+      }
+    }
+    runs.push_back(size);
+    a.resize(a_same ? 0 : size);
+    b.resize(b_same ? 0 : size);
+    c.resize(c_same ? 0 : size);
+    d.resize(d_same ? 0 : size);
+    for (unsigned int i = 0; i < size; ++i) {
+      const FunctionObj<T> &h = i < size1 ? f_obj1[i] : f_obj2[i - size1];
+      if (!a_same)
+        a[i] = h.a;
+      if (!b_same)
+        b[i] = h.b;
+      if (!c_same)
+        c[i] = h.c;
+      if (!d_same)
+        d[i] = h.d;
+    }
+    SetTypes(runs, types);
+    SetFill();
+  }
+
+  // Stores the concatenation of f_vec1 and f_vec2, which keeps a parameter in
+  // compact form if it is the same for all elements of both.
+  void Assign(const FunctionVec &f_vec1, const FunctionVec &f_vec2) {
+    FunctionVec h;
+    size_t size1 = f_vec1.size, size2 = f_vec2.size;
+    h.size = size1 + size2;
+    ConcatParam(f_vec1.a, f_vec1.a_all, size1, f_vec2.a, f_vec2.a_all, size2,
+                &h.a, &h.a_all);
+    ConcatParam(f_vec1.b, f_vec1.b_all, size1, f_vec2.b, f_vec2.b_all, size2,
+                &h.b, &h.b_all);
+    ConcatParam(f_vec1.c, f_vec1.c_all, size1, f_vec2.c, f_vec2.c_all, size2,
+                &h.c, &h.c_all);
+    ConcatParam(f_vec1.d, f_vec1.d_all, size1, f_vec2.d, f_vec2.d_all, size2,
+                &h.d, &h.d_all);
+    std::vector<size_t> runs, runs2;
+    std::vector<unsigned char> types, types2;
+    f_vec1.Runs(&runs, &types);
+    f_vec2.Runs(&runs2, &types2);
+    runs.pop_back();
+    for (unsigned int r = 0; r < types2.size(); ++r) {
+      if (types.empty() || types2[r] != types.back()) {
+        runs.push_back(size1 + runs2[r]);
+        types.push_back(types2[r]);
+      }
+    }
+    runs.push_back(h.size);
+    h.SetTypes(runs, types);
+    h.SetFill();
+    std::swap(*this, h);
+  }
+
+  // Returns the elements begin, ..., end - 1.
+  FunctionVec Slice(size_t begin, size_t end) const {
+    FunctionVec h;
+    h.size = end - begin;
+    h.a_all = a_all;
+    h.b_all = b_all;
+    h.c_all = c_all;
+    h.d_all = d_all;
+    if (!a.empty())
+      h.a.assign(a.begin() + begin, a.begin() + end);
+    if (!b.empty())
+      h.b.assign(b.begin() + begin, b.begin() + end);
+    if (!c.empty())
+      h.c.assign(c.begin() + begin, c.begin() + end);
+    if (!d.empty())
+      h.d.assign(d.begin() + begin, d.begin() + end);
+    std::vector<size_t> runs, runs_h;
+    std::vector<unsigned char> types, types_h;
+    Runs(&runs, &types);
+    for (unsigned int r = 0; r < types.size(); ++r) {
+      if (runs[r + 1] > begin && runs[r] < end) {
+        runs_h.push_back(std::max(runs[r], begin) - begin);
+        types_h.push_back(types[r]);
+      }
+    }
+    runs_h.push_back(h.size);
+    h.SetTypes(runs_h, types_h);
+    h.SetFill();
+    return h;
+  }
+
+  // Stores the parameters flagged in params (see ConstParams()) in arrays,
+  // such that they can be modified per element.
+  void Expand(unsigned int params) {
+    if ((params & kConstA) && a.empty())
+      a.assign(size, a_all);
+    if ((params & kConstB) && b.empty())
+      b.assign(size, b_all);
+    if ((params & kConstC) && c.empty())
+      c.assign(size, c_all);
+    if ((params & kConstD) && d.empty())
+      d.assign(size, d_all);
+  }
+
+  // Returns true if each of the arrays a, b, c and d is empty or has size
+  // elements.
+  bool Valid() const {
+    return (a.empty() || a.size() == size) && (b.empty() || b.size() == size)
+        && (c.empty() || c.size() == size) && (d.empty() || d.size() == size);
+  }
+
+  // Returns the flags of the parameters that are the same for all elements,
+  // which select the specialized kernels.
+  unsigned int ConstParams() const {
+    return (a.empty() ? kConstA : 0) | (b.empty() ? kConstB : 0) |
+        (c.empty() ? kConstC : 0) | (d.empty() ? kConstD : 0);
+  }
+
+  // Pointers to the parameters of element begin, for up to kProxChunk
+  // consecutive elements.
+  const T *ParamA(size_t begin) const {
+    return a.empty() ? fill.data() : a.data() + begin;
+  }
+  const T *ParamB(size_t begin) const {
+    return b.empty() ? fill.data() + kProxChunk : b.data() + begin;
+  }
+  const T *ParamC(size_t begin) const {
+    return c.empty() ? fill.data() + 2 * kProxChunk : c.data() + begin;
+  }
+  const T *ParamD(size_t begin) const {
+    return d.empty() ? fill.data() + 3 * kProxChunk : d.data() + begin;
+  }
+
+ private:
+  // Concatenates the parameter arrays p1 and p2 (or their values p1_all and
+  // p2_all if empty) of size1 and size2 elements.
+  static void ConcatParam(const Array &p1, T p1_all, size_t size1,
+                          const Array &p2, T p2_all, size_t size2, Array *p,
+                          T *p_all) {
+    *p_all = size1 > 0 ? p1_all : p2_all;
+    p->clear();
+    if (p1.empty() && p2.empty() &&
+        (size1 == 0 || size2 == 0 || p1_all == p2_all))
+      return;
+    p->reserve(size1 + size2);
+    if (p1.empty())
+      p->resize(size1, p1_all);
+    else
+      p->insert(p->end(), p1.begin(), p1.end());
+    if (p2.empty())
+      p->resize(size1 + size2, p2_all);
+    else
+      p->insert(p->end(), p2.begin(), p2.end());
+  }
+
+  // Returns the runs of equal type, as run_begin and run_f.
+  void Runs(std::vector<size_t> *runs, std::vector<unsigned char> *types)
+      const {
+    if (f.empty()) {
+      *runs = run_begin;
+      *types = run_f;
+      if (runs->empty())
+        runs->push_back(size);
+      return;
+    }
+    runs->clear();
+    types->clear();
+    for (unsigned int i = 0; i < size; ++i) {
+      if (i == 0 || f[i] != types->back()) {
+        runs->push_back(i);
+        types->push_back(f[i]);
+      }
+    }
+    runs->push_back(size);
+  }
+
+  // Stores the runs of equal type, or the type of each element if the runs
+  // are short.
+  void SetTypes(const std::vector<size_t> &runs,
+                const std::vector<unsigned char> &types) {
+    run_begin.clear();
+    run_f.clear();
+    f.clear();
+    if (kProxMinRun * types.size() > size) {
+      f.resize(size);
+      for (unsigned int r = 0; r < types.size(); ++r)
+        std::fill(f.begin() + runs[r], f.begin() + runs[r + 1], types[r]);
+    } else {
+      run_begin = runs;
+      run_f = types;
+    }
+  }
+
+  void SetFill() {
+    fill.resize(4 * kProxChunk);
+    std::fill(fill.begin(), fill.begin() + kProxChunk, a_all);
+    std::fill(fill.begin() + kProxChunk, fill.begin() + 2 * kProxChunk,
+              b_all);
+    std::fill(fill.begin() + 2 * kProxChunk, fill.begin() + 3 * kProxChunk,
+              c_all);
+    std::fill(fill.begin() + 3 * kProxChunk, fill.end(), d_all);
+  }
+};
+
+namespace {
+// Evaluates Prox{F}(x_in[i]) -> x_out[i] for a run of len elements of type F
+// with parameters a[i], b[i], c[i] and d[i]. The parameters flagged in the
+// mask C (see ConstParams()) are the same for all elements and are read
+// once, so that the compiler can hoist the computations that only depend on
+// them, such as rho / (c * a * a), out of the loop.
+template <Function F, unsigned int C, typename T>
+void ProxKernel(size_t len, T rho, const T *x_in, const T *a, const T *b,
+                const T *c, const T *d, T *x_out) {
+  const T a0 = a[0], b0 = b[0], c0 = c[0], d0 = d[0];
+  #pragma omp simd
+  for (unsigned int i = 0; i < len; ++i)
+    x_out[i] = ProxEval(F, x_in[i], C & kConstA ? a0 : a[i],
+                        C & kConstB ? b0 : b[i], C & kConstC ? c0 : c[i],
+                        C & kConstD ? d0 : d[i], rho);
+}
+
+// Returns Sum_i Func{F}(x_in[i]) for a run of len elements of type F.
+template <Function F, unsigned int C, typename T>
+T FuncKernel(size_t len, const T *x_in, const T *a, const T *b, const T *c,
+             const T *d) {
+  const T a0 = a[0], b0 = b[0], c0 = c[0], d0 = d[0];
+  T sum = 0;
+  #pragma omp simd reduction(+:sum)
+  for (unsigned int i = 0; i < len; ++i)
+    sum += FuncEval(F, x_in[i], C & kConstA ? a0 : a[i],
+                    C & kConstB ? b0 : b[i], C & kConstC ? c0 : c[i],
+                    C & kConstD ? d0 : d[i]);
+  return sum;
+}
+
+// Selects the kernel for the mask con of constant parameters. Specialized
+// kernels exist for uniform functions (as in the lasso) and for functions
+// where only b varies (as in least squares); all other masks use the
+// general kernel.
+template <Function F, typename T>
+void ProxRun(unsigned int con, size_t len, T rho, const T *x_in, const T *a,
+             const T *b, const T *c, const T *d, T *x_out) {
+  if (con == kConstAll)
+    ProxKernel<F, kConstAll>(len, rho, x_in, a, b, c, d, x_out);
+  else if (con == (kConstAll & ~kConstB))
+    ProxKernel<F, kConstAll & ~kConstB>(len, rho, x_in, a, b, c, d, x_out);
+  else
+    ProxKernel<F, 0>(len, rho, x_in, a, b, c, d, x_out);
+}
+
+template <Function F, typename T>
+T FuncRun(unsigned int con, size_t len, const T *x_in, const T *a,
+          const T *b, const T *c, const T *d) {
+  if (con == kConstAll)
+    return FuncKernel<F, kConstAll>(len, x_in, a, b, c, d);
+  else if (con == (kConstAll & ~kConstB))
+    return FuncKernel<F, kConstAll & ~kConstB>(len, x_in, a, b, c, d);
+  else
+    return FuncKernel<F, 0>(len, x_in, a, b, c, d);
+}
+
+// Dispatches ProxRun() on the function type f.
+template <typename T>
+void ProxRun(Function f, unsigned int con, size_t len, T rho, const T *x_in,
+             const T *a, const T *b, const T *c, const T *d, T *x_out) {
+  switch (f) {
+    case kAbs:
+      return ProxRun<kAbs>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kHuber:
+      return ProxRun<kHuber>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kIdentity:
+      return ProxRun<kIdentity>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kIndBox01:
+      return ProxRun<kIndBox01>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kIndEq0:
+      return ProxRun<kIndEq0>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kIndGe0:
+      return ProxRun<kIndGe0>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kIndLe0:
+      return ProxRun<kIndLe0>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kNegLog:
+      return ProxRun<kNegLog>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kLogistic:
+      return ProxRun<kLogistic>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kMaxNeg0:
+      return ProxRun<kMaxNeg0>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kMaxPos0:
+      return ProxRun<kMaxPos0>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kSquare:
+      return ProxRun<kSquare>(con, len, rho, x_in, a, b, c, d, x_out);
+    case kZero: default:
+      return ProxRun<kZero>(con, len, rho, x_in, a, b, c, d, x_out);
+  }
+}
+
+// Dispatches FuncRun() on the function type f.
+template <typename T>
+T FuncRun(Function f, unsigned int con, size_t len, const T *x_in,
+          const T *a, const T *b, const T *c, const T *d) {
+  switch (f) {
+    case kAbs:
+      return FuncRun<kAbs>(con, len, x_in, a, b, c, d);
+    case kHuber:
+      return FuncRun<kHuber>(con, len, x_in, a, b, c, d);
+    case kIdentity:
+      return FuncRun<kIdentity>(con, len, x_in, a, b, c, d);
+    case kIndBox01:
+      return FuncRun<kIndBox01>(con, len, x_in, a, b, c, d);
+    case kIndEq0:
+      return FuncRun<kIndEq0>(con, len, x_in, a, b, c, d);
+    case kIndGe0:
+      return FuncRun<kIndGe0>(con, len, x_in, a, b, c, d);
+    case kIndLe0:
+      return FuncRun<kIndLe0>(con, len, x_in, a, b, c, d);
+    case kNegLog:
+      return FuncRun<kNegLog>(con, len, x_in, a, b, c, d);
+    case kLogistic:
+      return FuncRun<kLogistic>(con, len, x_in, a, b, c, d);
+    case kMaxNeg0:
+      return FuncRun<kMaxNeg0>(con, len, x_in, a, b, c, d);
+    case kMaxPos0:
+      return FuncRun<kMaxPos0>(con, len, x_in, a, b, c, d);
+    case kSquare:
+      return FuncRun<kSquare>(con, len, x_in, a, b, c, d);
+    case kZero: default:
+      return FuncRun<kZero>(con, len, x_in, a, b, c, d);
+  }
+}
+}  // namespace
+
+// Evaluates Prox{f_vec[i]}(x_in[i - begin]) -> x_out[i - begin] for the len
+// elements begin <= i < begin + len, where len is at most kProxChunk.
+template <typename T>
+void ProxEvalChunk(const FunctionVec<T> &f_vec, size_t begin, size_t len,
+                   T rho, const T *x_in, T *x_out) {
+  const T *a = f_vec.ParamA(begin);
+  const T *b = f_vec.ParamB(begin);
+  const T *c = f_vec.ParamC(begin);
+  const T *d = f_vec.ParamD(begin);
+  if (!f_vec.f.empty()) {
+    for (unsigned int i = 0; i < len; ++i)
+      x_out[i] = ProxEval(static_cast<Function>(f_vec.f[begin + i]), x_in[i],
+                          a[i], b[i], c[i], d[i], rho);
+    return;
+  }
+  unsigned int con = f_vec.ConstParams();
+  size_t end = begin + len;
+  size_t r = std::upper_bound(f_vec.run_begin.begin(), f_vec.run_begin.end(),
+                              begin) - f_vec.run_begin.begin() - 1;
+  for (size_t i = begin; i < end; ++r) {
+    size_t run_end = std::min(f_vec.run_begin[r + 1], end);
+    size_t k = i - begin;
+    ProxRun(static_cast<Function>(f_vec.run_f[r]), con, run_end - i, rho,
+            x_in + k, a + k, b + k, c + k, d + k, x_out + k);
+    i = run_end;
+  }
+}
+
+// Returns Sum_i Func{f_vec[i]}(x_in[i - begin]) over the len elements
+// begin <= i < begin + len, where len is at most kProxChunk.
+template <typename T>
+T FuncEvalChunk(const FunctionVec<T> &f_vec, size_t begin, size_t len,
+                const T *x_in) {
+  const T *a = f_vec.ParamA(begin);
+  const T *b = f_vec.ParamB(begin);
+  const T *c = f_vec.ParamC(begin);
+  const T *d = f_vec.ParamD(begin);
+  T sum = 0;
+  if (!f_vec.f.empty()) {
+    for (unsigned int i = 0; i < len; ++i)
+      sum += FuncEval(static_cast<Function>(f_vec.f[begin + i]), x_in[i],
+                      a[i], b[i], c[i], d[i]);
+    return sum;
+  }
+  unsigned int con = f_vec.ConstParams();
+  size_t end = begin + len;
+  size_t r = std::upper_bound(f_vec.run_begin.begin(), f_vec.run_begin.end(),
+                              begin) - f_vec.run_begin.begin() - 1;
+  for (size_t i = begin; i < end; ++r) {
+    size_t run_end = std::min(f_vec.run_begin[r + 1], end);
+    size_t k = i - begin;
+    sum += FuncRun(static_cast<Function>(f_vec.run_f[r]), con, run_end - i,
+                   x_in + k, a + k, b + k, c + k, d + k);
+    i = run_end;
+  }
+  return sum;
+}
+
+// Evaluates the proximal operator Prox{f_vec[i]}(x_in[i]) -> x_out[i].
+template <typename T>
+void ProxEval(const FunctionVec<T> &f_vec, T rho, const T* x_in, T* x_out) {
+  size_t size = f_vec.size;
+  #pragma omp parallel for schedule(static) if (size >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < size; i += kProxChunk)
+    ProxEvalChunk(f_vec, i, std::min<size_t>(kProxChunk, size - i), rho,
+                  x_in + i, x_out + i);
+}
+
+// Returns evalution of Sum_i Func{f_vec[i]}(x_in[i]).
+template <typename T>
+T FuncEval(const FunctionVec<T> &f_vec, const T* x_in) {
+  size_t size = f_vec.size;
+  T sum = 0;
+  #pragma omp parallel for schedule(static) reduction(+:sum) \
+      if (size >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < size; i += kProxChunk)
+    sum += FuncEvalChunk(f_vec, i, std::min<size_t>(kProxChunk, size - i),
+                         x_in + i);
+  return sum;
+}
+
 #ifdef __CUDACC__
 template <typename T>
 struct ProxEvalF : thrust::binary_function<FunctionObj<T>, T, T> {
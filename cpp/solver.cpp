@@ -1,11 +1,23 @@
-#include <gsl/gsl_blas.h>
 #include <gsl/gsl_linalg.h>
 #include <gsl/gsl_matrix.h>
+#include <gsl/gsl_permutation.h>
 #include <gsl/gsl_vector.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "gsl_wrap.hpp"
+#include "ldl.hpp"
 #include "timer.hpp"
 #include "solver.hpp"
 
@@ -14,114 +26,2768 @@
 extern "C" int mexPrintf(const char* fmt, ...);
 #endif  // __MEX__
 
-template<>
-void Solver(AdmmData<double, double*> *admm_data) {
-  // Extract values from admm_data
-  size_t n = admm_data->n;
-  size_t m = admm_data->m;
+namespace {
+// Anderson acceleration state for the fixed-point map u = (z, zt) -> F(u).
+// Rows of dF and dG hold differences of consecutive residuals f = F(u) - u
+// and map outputs g = F(u) respectively, stored as a circular buffer. The
+// small mem x mem systems are always solved in double precision.
+template <typename T>
+struct Anderson {
+  unsigned int mem, count, next;
+  bool have_prev, accelerated;
+  double nrm_f_prev;
+  gsl::vector<T> *u, *f, *g, *f_new;
+  gsl::matrix<T> *dF, *dG;
+
+  // Gram matrices FF = dF^T dF and GF = dG^T dF, updated incrementally.
+  gsl_matrix *FF, *GF, *M;
+  gsl_vector *rhs, *gamma;
+  gsl_permutation *perm;
+};
+
+template <typename T>
+Anderson<T> *AndersonAlloc(unsigned int mem, size_t dim) {
+  Anderson<T> *aa = new Anderson<T>;
+  aa->mem = mem;
+  aa->u = gsl::vector_alloc<T>(dim);
+  aa->f = gsl::vector_alloc<T>(dim);
+  aa->g = gsl::vector_alloc<T>(dim);
+  aa->f_new = gsl::vector_alloc<T>(dim);
+  gsl::vector_set_zero(aa->u);
+  gsl::vector_set_zero(aa->f);
+  gsl::vector_set_zero(aa->g);
+  gsl::vector_set_zero(aa->f_new);
+  aa->dF = gsl::matrix_calloc<T>(mem, dim);
+  aa->dG = gsl::matrix_calloc<T>(mem, dim);
+  aa->FF = gsl_matrix_calloc(mem, mem);
+  aa->GF = gsl_matrix_calloc(mem, mem);
+  aa->M = gsl_matrix_calloc(mem, mem);
+  aa->rhs = gsl_vector_calloc(mem);
+  aa->gamma = gsl_vector_calloc(mem);
+  aa->perm = gsl_permutation_alloc(1);
+  return aa;
+}
+
+template <typename T>
+void AndersonFree(Anderson<T> *aa) {
+  if (aa == 0)
+    return;
+  gsl::vector_free(aa->u);
+  gsl::vector_free(aa->f);
+  gsl::vector_free(aa->g);
+  gsl::vector_free(aa->f_new);
+  gsl::matrix_free(aa->dF);
+  gsl::matrix_free(aa->dG);
+  gsl_matrix_free(aa->FF);
+  gsl_matrix_free(aa->GF);
+  gsl_matrix_free(aa->M);
+  gsl_vector_free(aa->rhs);
+  gsl_vector_free(aa->gamma);
+  gsl_permutation_free(aa->perm);
+  delete aa;
+}
+
+template <typename T>
+void AndersonReset(Anderson<T> *aa) {
+  aa->count = 0;
+  aa->next = 0;
+  aa->have_prev = false;
+  aa->accelerated = false;
+}
+
+// Copies (z, zt) to/from the stacked vector u.
+template <typename T>
+void AndersonStack(const gsl::vector<T> *z, const gsl::vector<T> *zt,
+                   gsl::vector<T> *u) {
+  gsl::vector_view<T> u_z = gsl::vector_subvector(u, 0, z->size);
+  gsl::vector_view<T> u_zt = gsl::vector_subvector(u, z->size, zt->size);
+  gsl::vector_memcpy(&u_z.vector, z);
+  gsl::vector_memcpy(&u_zt.vector, zt);
+}
+
+template <typename T>
+void AndersonUnstack(gsl::vector<T> *u, gsl::vector<T> *z,
+                     gsl::vector<T> *zt) {
+  gsl::vector_view<T> u_z = gsl::vector_subvector(u, 0, z->size);
+  gsl::vector_view<T> u_zt = gsl::vector_subvector(u, z->size, zt->size);
+  gsl::vector_memcpy(z, &u_z.vector);
+  gsl::vector_memcpy(zt, &u_zt.vector);
+}
+
+// Given the output (z, zt) = F(u) of one ADMM iteration applied to aa->u,
+// overwrites (z, zt) with the extrapolated iterate. If the previous step
+// was extrapolated and the fixed-point residual grew by more than a factor
+// safeguard, the step is rejected in favor of the last plain ADMM iterate
+// and the memory is cleared.
+template <typename T>
+void AndersonStep(Anderson<T> *aa, bool type1, double safeguard, double reg,
+                  gsl::vector<T> *z, gsl::vector<T> *zt) {
+  // f_new = F(u) - u.
+  AndersonStack<T>(z, zt, aa->f_new);
+  gsl::vector_sub(aa->f_new, aa->u);
+  double nrm_f = gsl::blas_nrm2(aa->f_new);
+
+  if (aa->accelerated && nrm_f > safeguard * aa->nrm_f_prev) {
+    AndersonUnstack<T>(aa->g, z, zt);
+    AndersonReset(aa);
+    return;
+  }
+
+  // Append differences to memory and update Gram matrices.
+  if (aa->have_prev) {
+    unsigned int c = aa->next;
+    gsl::vector_view<T> dF_c = gsl::matrix_row(aa->dF, c);
+    gsl::vector_view<T> dG_c = gsl::matrix_row(aa->dG, c);
+    gsl::vector_memcpy(&dF_c.vector, aa->f_new);
+    gsl::vector_sub(&dF_c.vector, aa->f);
+    AndersonStack<T>(z, zt, &dG_c.vector);
+    gsl::vector_sub(&dG_c.vector, aa->g);
+    aa->count = std::min(aa->count + 1, aa->mem);
+    aa->next = (aa->next + 1) % aa->mem;
+    for (unsigned int j = 0; j < aa->count; ++j) {
+      gsl::vector_view<T> dF_j = gsl::matrix_row(aa->dF, j);
+      gsl::vector_view<T> dG_j = gsl::matrix_row(aa->dG, j);
+      double ff = gsl::blas_dot(&dF_c.vector, &dF_j.vector);
+      double gf = gsl::blas_dot(&dG_c.vector, &dF_j.vector);
+      double fg = gsl::blas_dot(&dG_j.vector, &dF_c.vector);
+      gsl_matrix_set(aa->FF, c, j, ff);
+      gsl_matrix_set(aa->FF, j, c, ff);
+      gsl_matrix_set(aa->GF, c, j, gf);
+      gsl_matrix_set(aa->GF, j, c, fg);
+    }
+  }
+  gsl::vector_memcpy(aa->f, aa->f_new);
+  AndersonStack<T>(z, zt, aa->g);
+  aa->have_prev = true;
+  aa->nrm_f_prev = nrm_f;
+  aa->accelerated = false;
+
+  if (aa->count == 0)
+    return;
+
+  // Solve for the mixing coefficients gamma. Type-II minimizes
+  // ||f - dF gamma||_2, while type-I solves dU^T dF gamma = dU^T f, where
+  // dU = dG - dF are the differences of the inputs u.
+  size_t count = aa->count;
+  gsl_matrix_view M = gsl_matrix_submatrix(aa->M, 0, 0, count, count);
+  gsl_vector_view rhs = gsl_vector_subvector(aa->rhs, 0, count);
+  gsl_vector_view gamma = gsl_vector_subvector(aa->gamma, 0, count);
+  double trace = 0.0;
+  for (unsigned int i = 0; i < count; ++i) {
+    gsl::vector_view<T> dF_i = gsl::matrix_row(aa->dF, i);
+    double rhs_i = gsl::blas_dot(&dF_i.vector, aa->f);
+    if (type1) {
+      gsl::vector_view<T> dG_i = gsl::matrix_row(aa->dG, i);
+      rhs_i = gsl::blas_dot(&dG_i.vector, aa->f) - rhs_i;
+    }
+    gsl_vector_set(&rhs.vector, i, rhs_i);
+    for (unsigned int j = 0; j < count; ++j) {
+      double m_ij = gsl_matrix_get(aa->FF, i, j);
+      if (type1)
+        m_ij = gsl_matrix_get(aa->GF, i, j) - m_ij;
+      gsl_matrix_set(&M.matrix, i, j, m_ij);
+    }
+    trace += gsl_matrix_get(aa->FF, i, i);
+  }
+  double lambda = reg * trace / static_cast<double>(count);
+  for (unsigned int i = 0; i < count; ++i)
+    *gsl_matrix_ptr(&M.matrix, i, i) += lambda;
+
+  if (aa->perm->size != count) {
+    gsl_permutation_free(aa->perm);
+    aa->perm = gsl_permutation_alloc(count);
+  }
+  int signum;
+  gsl_linalg_LU_decomp(&M.matrix, aa->perm, &signum);
+  for (unsigned int i = 0; i < count; ++i)
+    if (std::fabs(gsl_matrix_get(&M.matrix, i, i)) <= 1e-14 * trace)
+      return;
+  gsl_linalg_LU_solve(&M.matrix, aa->perm, &rhs.vector, &gamma.vector);
+
+  // u_next = g - dG gamma.
+  gsl::vector_memcpy(aa->f_new, aa->g);
+  for (unsigned int i = 0; i < count; ++i) {
+    double gamma_i = gsl_vector_get(&gamma.vector, i);
+    if (!std::isfinite(gamma_i))
+      return;
+    gsl::vector_view<T> dG_i = gsl::matrix_row(aa->dG, i);
+    gsl::blas_axpy(static_cast<T>(-gamma_i), &dG_i.vector, aa->f_new);
+  }
+  AndersonUnstack<T>(aa->f_new, z, zt);
+  aa->accelerated = true;
+}
+}  // namespace
+
+namespace {
+// Computes diagonal scalings d and e such that diag(d) * A * diag(e) has rows
+// and columns of approximately unit infinity-norm, using num_iter passes of
+// Ruiz's method. Ae is overwritten with the scaled matrix.
+template <typename T>
+void Equilibrate(const gsl::matrix<T> *A, unsigned int num_iter,
+                 gsl::matrix<T> *Ae, gsl::vector<T> *d, gsl::vector<T> *e) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  size_t m = A->size1;
+  size_t n = A->size2;
+  gsl::matrix_memcpy(Ae, A);
+  gsl::vector_set_all(d, kOne);
+  gsl::vector_set_all(e, kOne);
+  gsl::vector<T> *s = gsl::vector_alloc<T>(n);
+  for (unsigned int k = 0; k < num_iter; ++k) {
+    // Scale rows.
+    for (unsigned int i = 0; i < m; ++i) {
+      gsl::vector_view<T> row = gsl::matrix_row(Ae, i);
+      T nrm = std::fabs(gsl::vector_get(&row.vector,
+                                        gsl::blas_iamax(&row.vector)));
+      if (nrm > kZero) {
+        T scale = kOne / std::sqrt(nrm);
+        gsl::blas_scal(scale, &row.vector);
+        *gsl::vector_ptr(d, i) *= scale;
+      }
+    }
+
+    // Scale columns. Accumulate column norms row by row, since Ae is stored
+    // in row-major order.
+    gsl::vector_set_zero(s);
+    for (unsigned int i = 0; i < m; ++i) {
+      const T *row = gsl::matrix_const_ptr(Ae, i, 0);
+      for (unsigned int j = 0; j < n; ++j)
+        *gsl::vector_ptr(s, j) = std::max(gsl::vector_get(s, j),
+                                          std::fabs(row[j]));
+    }
+    for (unsigned int j = 0; j < n; ++j) {
+      T nrm = gsl::vector_get(s, j);
+      gsl::vector_set(s, j, nrm > kZero ? kOne / std::sqrt(nrm) : kOne);
+    }
+    for (unsigned int i = 0; i < m; ++i) {
+      gsl::vector_view<T> row = gsl::matrix_row(Ae, i);
+      gsl::vector_mul(&row.vector, s);
+    }
+    gsl::vector_mul(e, s);
+  }
+  gsl::vector_free(s);
+
+  // Normalize such that ||Ae||_2 is approximately 1, by a few steps of the
+  // power method on Ae^TAe.
+  const unsigned int kNormIter = 10;
+  gsl::vector<T> *v = gsl::vector_alloc<T>(n);
+  gsl::vector<T> *u = gsl::vector_alloc<T>(m);
+  gsl::vector_set_all(v, kOne / std::sqrt(static_cast<T>(n)));
+  T nrm_A = kZero;
+  for (unsigned int k = 0; k < kNormIter; ++k) {
+    gsl::blas_gemv(CblasNoTrans, kOne, Ae, v, kZero, u);
+    gsl::blas_gemv(CblasTrans, kOne, Ae, u, kZero, v);
+    T nrm_v = gsl::blas_nrm2(v);
+    if (nrm_v == kZero)
+      break;
+    nrm_A = std::sqrt(nrm_v);
+    gsl::blas_scal(kOne / nrm_v, v);
+  }
+  if (nrm_A > kZero) {
+    T scale = kOne / std::sqrt(nrm_A);
+    gsl::matrix_scale(Ae, scale * scale);
+    gsl::blas_scal(scale, d);
+    gsl::blas_scal(scale, e);
+  }
+  gsl::vector_free(v);
+  gsl::vector_free(u);
+}
+
+// Rewrites h = (g, f), with g of length n and f of length m, for the
+// equilibrated problem in the variables (diag(e)^-1 * x, diag(d) * y). The
+// parameter d is left in compact form if it is zero for all elements.
+template <typename T>
+void ScaleFunctions(const gsl::vector<T> *d, const gsl::vector<T> *e,
+                    FunctionVec<T> *h) {
+  size_t n = e->size;
+  bool scale_d = !h->d.empty() || h->d_all != static_cast<T>(0);
+  h->Expand(scale_d ? kConstA | kConstD : kConstA);
+  for (unsigned int j = 0; j < n; ++j) {
+    h->a[j] *= gsl::vector_get(e, j);
+    if (scale_d)
+      h->d[j] *= gsl::vector_get(e, j);
+  }
+  for (unsigned int i = 0; i < d->size; ++i) {
+    h->a[n + i] /= gsl::vector_get(d, i);
+    if (scale_d)
+      h->d[n + i] /= gsl::vector_get(d, i);
+  }
+}
+
+// Returns f in structure-of-arrays form, which is f_vec if f is empty and is
+// otherwise stored in f_tmp.
+template <typename T>
+const FunctionVec<T> &Functions(const std::vector<FunctionObj<T> > &f,
+                                const FunctionVec<T> &f_vec,
+                                FunctionVec<T> *f_tmp) {
+  if (f.empty())
+    return f_vec;
+  f_tmp->Assign(f, std::vector<FunctionObj<T> >());
+  return *f_tmp;
+}
+
+// Returns true if f and g of admm_data (or f_vec and g_vec in their place)
+// have m and n elements.
+template <typename T, typename M>
+bool FunctionsMatch(const AdmmData<T, M> &admm_data) {
+  bool f_match = admm_data.f.empty() ?
+      admm_data.f_vec.size == admm_data.m && admm_data.f_vec.Valid() :
+      admm_data.f.size() == admm_data.m;
+  bool g_match = admm_data.g.empty() ?
+      admm_data.g_vec.size == admm_data.n && admm_data.g_vec.Valid() :
+      admm_data.g.size() == admm_data.n;
+  return f_match && g_match;
+}
+}  // namespace
+
+namespace {
+// Computes y = alpha * A * x + beta * y for an m x n matrix A in compressed
+// sparse row format (ptr, ind, val).
+template <typename T>
+void CsrGemv(size_t m, const int *ptr, const int *ind, const T *val,
+             T alpha, const gsl::vector<T> *x, T beta, gsl::vector<T> *y) {
+  #pragma omp parallel for schedule(static) if (m >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < m; ++i) {
+    T sum = static_cast<T>(0);
+    for (int p = ptr[i]; p < ptr[i + 1]; ++p)
+      sum += val[p] * gsl::vector_get(x, ind[p]);
+    gsl::vector_set(y, i, alpha * sum + beta * gsl::vector_get(y, i));
+  }
+}
+
+// Computes y = alpha * op(A) * x + beta * y for a single precision matrix A
+// and vectors x and y in precision T, which must have unit stride. Products
+// are accumulated in precision T, so that only the storage of A is reduced.
+template <typename T>
+void MixedGemv(CBLAS_TRANSPOSE_t trans, T alpha, const gsl::matrix<float> *A,
+               const gsl::vector<T> *x, T beta, gsl::vector<T> *y) {
+  size_t m = A->size1;
+  size_t n = A->size2;
+  const T *xd = x->data;
+  T *yd = y->data;
+  if (trans == CblasNoTrans) {
+    #pragma omp parallel for schedule(static) if (m * n >= SOLVER_OMP_MIN_LEN)
+    for (size_t i = 0; i < m; ++i) {
+      // Use independent partial sums to avoid serializing on one
+      // accumulator.
+      const float *row = gsl::matrix_const_ptr(A, i, 0);
+      T sum[4] = {0, 0, 0, 0};
+      size_t j = 0;
+      for (; j + 4 <= n; j += 4)
+        for (size_t l = 0; l < 4; ++l)
+          sum[l] += row[j + l] * xd[j + l];
+      for (; j < n; ++j)
+        sum[0] += row[j] * xd[j];
+      T dot = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+      yd[i] = alpha * dot + beta * yd[i];
+    }
+  } else {
+    // Each thread updates its own block of y, traversing all rows of A.
+    const size_t kBlock = 1024;
+    gsl::vector_scale(y, beta);
+    #pragma omp parallel for schedule(static) if (m * n >= SOLVER_OMP_MIN_LEN)
+    for (size_t jb = 0; jb < n; jb += kBlock) {
+      size_t j_end = std::min(jb + kBlock, n);
+      for (size_t i = 0; i < m; ++i) {
+        const float *row = gsl::matrix_const_ptr(A, i, 0);
+        T x_i = alpha * xd[i];
+        for (size_t j = jb; j < j_end; ++j)
+          yd[j] += row[j] * x_i;
+      }
+    }
+  }
+}
+
+// Sparse version of Equilibrate(). The values val of the CSR matrix
+// (ptr, ind) are scaled in place.
+template <typename T>
+void EquilibrateCsr(size_t m, size_t n, const int *ptr, const int *ind,
+                    T *val, unsigned int num_iter, gsl::vector<T> *d,
+                    gsl::vector<T> *e) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  gsl::vector_set_all(d, kOne);
+  gsl::vector_set_all(e, kOne);
+  gsl::vector<T> *s = gsl::vector_alloc<T>(n);
+  for (unsigned int k = 0; k < num_iter; ++k) {
+    // Scale rows.
+    for (unsigned int i = 0; i < m; ++i) {
+      T nrm = kZero;
+      for (int p = ptr[i]; p < ptr[i + 1]; ++p)
+        nrm = std::max(nrm, std::fabs(val[p]));
+      if (nrm > kZero) {
+        T scale = kOne / std::sqrt(nrm);
+        for (int p = ptr[i]; p < ptr[i + 1]; ++p)
+          val[p] *= scale;
+        *gsl::vector_ptr(d, i) *= scale;
+      }
+    }
+
+    // Scale columns.
+    gsl::vector_set_zero(s);
+    for (int p = 0; p < ptr[m]; ++p)
+      *gsl::vector_ptr(s, ind[p]) = std::max(gsl::vector_get(s, ind[p]),
+                                             std::fabs(val[p]));
+    for (unsigned int j = 0; j < n; ++j) {
+      T nrm = gsl::vector_get(s, j);
+      gsl::vector_set(s, j, nrm > kZero ? kOne / std::sqrt(nrm) : kOne);
+    }
+    for (int p = 0; p < ptr[m]; ++p)
+      val[p] *= gsl::vector_get(s, ind[p]);
+    gsl::vector_mul(e, s);
+  }
+  gsl::vector_free(s);
+
+  // Normalize such that ||A||_2 is approximately 1. Products with A^T are
+  // formed by scattering the rows of A.
+  const unsigned int kNormIter = 10;
+  gsl::vector<T> *v = gsl::vector_alloc<T>(n);
+  gsl::vector<T> *u = gsl::vector_alloc<T>(m);
+  gsl::vector_set_all(v, kOne / std::sqrt(static_cast<T>(n)));
+  T nrm_A = kZero;
+  for (unsigned int k = 0; k < kNormIter; ++k) {
+    CsrGemv(m, ptr, ind, val, kOne, v, kZero, u);
+    gsl::vector_set_zero(v);
+    for (unsigned int i = 0; i < m; ++i)
+      for (int p = ptr[i]; p < ptr[i + 1]; ++p)
+        *gsl::vector_ptr(v, ind[p]) += val[p] * gsl::vector_get(u, i);
+    T nrm_v = gsl::blas_nrm2(v);
+    if (nrm_v == kZero)
+      break;
+    nrm_A = std::sqrt(nrm_v);
+    gsl::blas_scal(kOne / nrm_v, v);
+  }
+  if (nrm_A > kZero) {
+    T scale = kOne / std::sqrt(nrm_A);
+    for (int p = 0; p < ptr[m]; ++p)
+      val[p] *= scale * scale;
+    gsl::blas_scal(scale, d);
+    gsl::blas_scal(scale, e);
+  }
+  gsl::vector_free(v);
+  gsl::vector_free(u);
+}
+
+// Workspace for the indirect projection. The solution x of the previous
+// projection is kept as initial guess for the next one.
+template <typename T>
+struct CgWork {
+  unsigned int max_iter;
+  gsl::vector<T> *x, *b, *r, *p, *q, *s, *tmp;
+
+  // Inverse of the diagonal of (I + A^TA), used as preconditioner.
+  gsl::vector<T> *diag_inv;
+};
+
+template <typename T>
+CgWork<T> *CgAlloc(size_t m, size_t n, unsigned int max_iter) {
+  CgWork<T> *cg = new CgWork<T>;
+  cg->max_iter = max_iter;
+  cg->x = gsl::vector_calloc<T>(n);
+  cg->b = gsl::vector_alloc<T>(n);
+  cg->r = gsl::vector_alloc<T>(n);
+  cg->p = gsl::vector_alloc<T>(n);
+  cg->q = gsl::vector_alloc<T>(n);
+  cg->s = gsl::vector_alloc<T>(n);
+  cg->tmp = gsl::vector_alloc<T>(m);
+  cg->diag_inv = gsl::vector_alloc<T>(n);
+  return cg;
+}
+
+template <typename T>
+void CgFree(CgWork<T> *cg) {
+  if (cg == 0)
+    return;
+  gsl::vector_free(cg->x);
+  gsl::vector_free(cg->b);
+  gsl::vector_free(cg->r);
+  gsl::vector_free(cg->p);
+  gsl::vector_free(cg->q);
+  gsl::vector_free(cg->s);
+  gsl::vector_free(cg->tmp);
+  gsl::vector_free(cg->diag_inv);
+  delete cg;
+}
+}  // namespace
+
+// Projection onto the graph {(x, y) | y = A * x}, specialized for each
+// supported matrix type M.
+template <typename M>
+struct Projector;
+
+// Dense row-major A. Holds the Cholesky factor of (I + A^TA) if A is skinny
+// and of (I + AA^T) if A is fat, its inverse if the projection is explicit,
+// or the CG workspace if the projection is indirect.
+template <typename T>
+struct Projector<T*> {
+  size_t m, n;
+  const T *A_in;
+
+  // Equilibrated copy of A (null if A is used as is).
+  gsl::matrix<T> *Ae;
+  gsl::matrix_const_view<T> A;
+
+  // Cholesky factor of (I + A^TA) or (I + AA^T) and the product A^TA or AA^T
+  // (null if the projection is indirect).
+  gsl::matrix<T> *L, *AA;
+
+  // Inverse of (I + A^TA) or (I + AA^T) if the projection is explicit (null
+  // otherwise), in which case L and AA are null.
+  gsl::matrix<T> *P;
+
+  CgWork<T> *cg;
+
+  // Single precision copies of A, AA (with both triangles stored) and L if
+  // the projection is computed in mixed precision (null otherwise), in which
+  // case A, L and AA are not used. The vectors b and r hold the right-hand
+  // side and residual for iterative refinement, and Lr holds the residual in
+  // single precision.
+  gsl::matrix<float> *Af, *AAf, *Lf;
+  gsl::vector<T> *b, *r;
+  gsl::vector<float> *Lr;
+  unsigned int refine_iter;
+};
+
+// Sparse CSR A. Holds the LDL^T factorization of the quasi-definite KKT
+// matrix [I A^T; A -I], which avoids forming A^TA or AA^T, or the CG
+// workspace if the projection is indirect. The factorization is computed in
+// double precision regardless of T.
+template <typename T>
+struct Projector<CsrMatrix<T> > {
+  size_t m, n;
+  const T *val_in;
+
+  // Values of (the possibly equilibrated) A in CSR format, sharing the
+  // sparsity pattern (row_ptr, col_ind) of the input, and a copy of A in
+  // CSC format for products with A^T.
+  const int *row_ptr, *col_ind;
+  std::vector<T> val;
+  std::vector<int> col_ptr, row_ind;
+  std::vector<T> val_t;
+
+  LdlFactor ldl;
+  std::vector<double> rhs, work;
+
+  CgWork<T> *cg;
+};
+
+// Memory-mapped dense A, which is only accessed in blocks of block_rows rows.
+// Holds the same factorization (or its inverse) as for dense A in memory,
+// or the CG workspace if the projection is indirect.
+template <typename T>
+struct Projector<MappedMatrix<T> > {
+  size_t m, n, block_rows;
+  const T *val;
+
+  // Direction of the next pass over the blocks of A. Passes alternate
+  // between forward and backward, such that each pass starts with the blocks
+  // that the previous pass left in the page cache.
+  mutable bool forward;
+
+  gsl::matrix<T> *L, *AA, *P;
+
+  CgWork<T> *cg;
+};
+
+namespace {
+// Computes the Cholesky factor L of I + AA, where the lower triangle of AA
+// holds A^TA (or AA^T) for an m x n matrix A. If explicit_inverse is
+// selected, L and AA are replaced by the inverse P of I + AA and set to null,
+// and otherwise P is set to null.
+template <typename T>
+void FactorGram(size_t m, size_t n, Choice explicit_inverse,
+                gsl::matrix<T> **AA, gsl::matrix<T> **L, gsl::matrix<T> **P) {
+  const T kOne = static_cast<T>(1);
+  size_t min_dim = std::min(m, n);
+  *L = gsl::matrix_alloc<T>(min_dim, min_dim);
+  gsl::matrix_memcpy(*L, *AA);
+  for (unsigned int i = 0; i < min_dim; ++i)
+    *gsl::matrix_ptr(*L, i, i) += kOne;
+  gsl::linalg_cholesky_decomp(*L);
+  *P = 0;
+
+  // Form the inverse L^-T L^-1 by triangular solves with the identity. This
+  // costs 2 min_dim^3 flops, compared to min_dim^2 max(m, n) for forming
+  // A^TA or AA^T, so the automatic choice requires min_dim to be small
+  // relative to max(m, n).
+  size_t max_dim = std::max(m, n);
+  if (explicit_inverse == kOn ||
+      (explicit_inverse == kAuto && 4 * min_dim <= max_dim)) {
+    *P = gsl::matrix_calloc<T>(min_dim, min_dim);
+    for (unsigned int i = 0; i < min_dim; ++i)
+      gsl::matrix_set(*P, i, i, kOne);
+    gsl::blas_trsm(CblasLeft, CblasLower, CblasNoTrans, CblasNonUnit, kOne,
+                   *L, *P);
+    gsl::blas_trsm(CblasLeft, CblasLower, CblasTrans, CblasNonUnit, kOne,
+                   *L, *P);
+    gsl::matrix_free(*L);
+    gsl::matrix_free(*AA);
+    *L = 0;
+    *AA = 0;
+  }
+}
+
+// Sets up the projection for dense A. If equil_iter > 0, A is equilibrated
+// first and d and e are overwritten with the row and column scaling.
+// If indirect is set, no factorization is formed and projections are
+// computed by CG with at most cg_max_iter iterations. Otherwise, if mixed is
+// set, A is factored in single precision and each projection is refined by
+// refine_iter steps of iterative refinement, and if explicit_inverse is
+// selected, the inverse of the factored matrix is formed.
+template <typename T>
+Projector<T*> *ProjectorSetup(const T *A_in, size_t m, size_t n,
+                              unsigned int equil_iter, bool indirect,
+                              unsigned int cg_max_iter, bool mixed,
+                              unsigned int refine_iter,
+                              Choice explicit_inverse, gsl::vector<T> *d,
+                              gsl::vector<T> *e) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
   bool is_skinny = m >= n;
   size_t min_dim = std::min(m, n);
 
-  gsl_matrix_const_view A = gsl_matrix_const_view_array(admm_data->A, m, n);
+  Projector<T*> *proj = new Projector<T*>;
+  proj->m = m;
+  proj->n = n;
+  proj->A_in = A_in;
+  proj->Ae = 0;
+  proj->A = gsl::matrix_const_view_array(A_in, m, n);
+  proj->L = 0;
+  proj->AA = 0;
+  proj->P = 0;
+  proj->cg = 0;
+  proj->Af = 0;
+  proj->Lf = 0;
+  proj->refine_iter = refine_iter;
 
-  // Allocate data for ADMM variables.
-  gsl_vector *z = gsl_vector_calloc(m + n);
-  gsl_vector *zt = gsl_vector_calloc(m + n);
-  gsl_vector *z12 = gsl_vector_calloc(m + n);
-  gsl_vector *z_prev = gsl_vector_calloc(m + n);
-  gsl_matrix *L = gsl_matrix_calloc(min_dim, min_dim);
-  gsl_matrix *AA = gsl_matrix_calloc(min_dim, min_dim);
+  // Equilibrate A.
+  if (equil_iter > 0) {
+    proj->Ae = gsl::matrix_alloc<T>(m, n);
+    Equilibrate<T>(&proj->A.matrix, equil_iter, proj->Ae, d, e);
+    proj->A = gsl::matrix_const_view_array(proj->Ae->data, m, n);
+  }
 
-  // Create views for x and y components.
-  gsl_vector_view x = gsl_vector_subvector(z, 0, n);
-  gsl_vector_view y = gsl_vector_subvector(z, n, m);
-  gsl_vector_view xt = gsl_vector_subvector(zt, 0, n);
-  gsl_vector_view yt = gsl_vector_subvector(zt, n, m);
-  gsl_vector_view x12 = gsl_vector_subvector(z12, 0, n);
-  gsl_vector_view y12 = gsl_vector_subvector(z12, n, m);
+  // Compute the preconditioner 1 / diag(I + A^TA).
+  if (indirect) {
+    proj->cg = CgAlloc<T>(m, n, cg_max_iter);
+    gsl::vector_set_all(proj->cg->diag_inv, kOne);
+    for (unsigned int i = 0; i < m; ++i) {
+      for (unsigned int j = 0; j < n; ++j) {
+        T a_ij = gsl::matrix_get(&proj->A.matrix, i, j);
+        *gsl::vector_ptr(proj->cg->diag_inv, j) += a_ij * a_ij;
+      }
+    }
+    for (unsigned int j = 0; j < n; ++j)
+      gsl::vector_set(proj->cg->diag_inv, j,
+                      kOne / gsl::vector_get(proj->cg->diag_inv, j));
+    return proj;
+  }
 
-  // Compute cholesky decomposition of (I + A^TA) or (I + AA^T)
   CBLAS_TRANSPOSE_t mult_type = is_skinny ? CblasTrans : CblasNoTrans;
-  gsl_blas_dsyrk(CblasLower, mult_type, 1.0, &A.matrix, 0.0, AA);
-  gsl_matrix_memcpy(L, AA);
-  for (unsigned int i = 0; i < min_dim; ++i)
-    *gsl_matrix_ptr(L, i, i) += 1.0;
-  gsl_linalg_cholesky_decomp(L);
+
+  // Form A^TA or AA^T in precision T and round it to single precision,
+  // together with A and the cholesky factor of (I + A^TA) or (I + AA^T). The
+  // equilibrated copy of A in precision T is discarded.
+  if (mixed) {
+    gsl::matrix<T> *AA = gsl::matrix_calloc<T>(min_dim, min_dim);
+    gsl::blas_syrk(CblasLower, mult_type, kOne, &proj->A.matrix, kZero, AA);
+    proj->Af = gsl::matrix_alloc<float>(m, n);
+    for (unsigned int i = 0; i < m; ++i)
+      for (unsigned int j = 0; j < n; ++j)
+        gsl::matrix_set(proj->Af, i, j, static_cast<float>(
+            gsl::matrix_get(&proj->A.matrix, i, j)));
+    proj->AAf = gsl::matrix_alloc<float>(min_dim, min_dim);
+    proj->Lf = gsl::matrix_calloc<float>(min_dim, min_dim);
+    for (unsigned int i = 0; i < min_dim; ++i) {
+      for (unsigned int j = 0; j <= i; ++j) {
+        float aa_ij = static_cast<float>(gsl::matrix_get(AA, i, j));
+        gsl::matrix_set(proj->AAf, i, j, aa_ij);
+        gsl::matrix_set(proj->AAf, j, i, aa_ij);
+        gsl::matrix_set(proj->Lf, i, j, i == j ? aa_ij + 1.0f : aa_ij);
+      }
+    }
+    gsl::matrix_free(AA);
+    gsl::linalg_cholesky_decomp(proj->Lf);
+    if (proj->Ae != 0) {
+      gsl::matrix_free(proj->Ae);
+      proj->Ae = 0;
+      proj->A = gsl::matrix_const_view_array(A_in, m, n);
+    }
+    proj->b = gsl::vector_alloc<T>(min_dim);
+    proj->r = gsl::vector_alloc<T>(min_dim);
+    proj->Lr = gsl::vector_alloc<float>(min_dim);
+    return proj;
+  }
+
+  // Compute cholesky decomposition of (I + A^TA) or (I + AA^T)
+  proj->AA = gsl::matrix_calloc<T>(min_dim, min_dim);
+  gsl::blas_syrk(CblasLower, mult_type, kOne, &proj->A.matrix, kZero,
+                 proj->AA);
+  FactorGram<T>(m, n, explicit_inverse, &proj->AA, &proj->L, &proj->P);
+
+  return proj;
+}
+
+// Sets up the projection for sparse A. See the dense version. Mixed precision
+// and explicit inverses are not supported, since the LDL^T factorization is
+// always computed in double precision and its inverse is generally dense, and
+// are ignored with a warning.
+template <typename T>
+Projector<CsrMatrix<T> > *ProjectorSetup(const CsrMatrix<T> &A_in, size_t m,
+                                         size_t n, unsigned int equil_iter,
+                                         bool indirect,
+                                         unsigned int cg_max_iter, bool mixed,
+                                         unsigned int /*refine_iter*/,
+                                         Choice explicit_inverse,
+                                         gsl::vector<T> *d,
+                                         gsl::vector<T> *e) {
+  const T kOne = static_cast<T>(1);
+  if (mixed && !indirect)
+    fprintf(stderr, "WARNING: Mixed precision is not supported for sparse "
+            "A.\n");
+  if (explicit_inverse == kOn && !indirect)
+    fprintf(stderr, "WARNING: Explicit projection is not supported for "
+            "sparse A.\n");
+  Projector<CsrMatrix<T> > *proj = new Projector<CsrMatrix<T> >;
+  proj->m = m;
+  proj->n = n;
+  proj->val_in = A_in.val;
+  proj->row_ptr = A_in.row_ptr;
+  proj->col_ind = A_in.col_ind;
+  proj->cg = 0;
+  int nnz = A_in.row_ptr[m];
+  proj->val.assign(A_in.val, A_in.val + nnz);
+
+  // Equilibrate A.
+  if (equil_iter > 0)
+    EquilibrateCsr(m, n, proj->row_ptr, proj->col_ind, proj->val.data(),
+                   equil_iter, d, e);
+
+  // Transpose A to CSC format.
+  proj->col_ptr.assign(n + 1, 0);
+  proj->row_ind.resize(nnz);
+  proj->val_t.resize(nnz);
+  for (int p = 0; p < nnz; ++p)
+    proj->col_ptr[proj->col_ind[p] + 1]++;
+  for (unsigned int j = 0; j < n; ++j)
+    proj->col_ptr[j + 1] += proj->col_ptr[j];
+  std::vector<int> next(proj->col_ptr.begin(), proj->col_ptr.end() - 1);
+  for (unsigned int i = 0; i < m; ++i) {
+    for (int p = proj->row_ptr[i]; p < proj->row_ptr[i + 1]; ++p) {
+      int q = next[proj->col_ind[p]]++;
+      proj->row_ind[q] = i;
+      proj->val_t[q] = proj->val[p];
+    }
+  }
+
+  // Compute the preconditioner 1 / diag(I + A^TA).
+  if (indirect) {
+    proj->cg = CgAlloc<T>(m, n, cg_max_iter);
+    gsl::vector_set_all(proj->cg->diag_inv, kOne);
+    for (int p = 0; p < nnz; ++p)
+      *gsl::vector_ptr(proj->cg->diag_inv, proj->col_ind[p]) +=
+          proj->val[p] * proj->val[p];
+    for (unsigned int j = 0; j < n; ++j)
+      gsl::vector_set(proj->cg->diag_inv, j,
+                      kOne / gsl::vector_get(proj->cg->diag_inv, j));
+    return proj;
+  }
+
+  // Assemble the KKT matrix K = [I A^T; A -I] in CSC format (both triangles).
+  std::vector<int> Kp(m + n + 1), Ki(n + m + 2 * nnz);
+  std::vector<double> Kx(n + m + 2 * nnz);
+  int q = 0;
+  for (unsigned int j = 0; j < n; ++j) {
+    Kp[j] = q;
+    Ki[q] = j;
+    Kx[q++] = 1.0;
+    for (int p = proj->col_ptr[j]; p < proj->col_ptr[j + 1]; ++p) {
+      Ki[q] = static_cast<int>(n) + proj->row_ind[p];
+      Kx[q++] = proj->val_t[p];
+    }
+  }
+  for (unsigned int i = 0; i < m; ++i) {
+    Kp[n + i] = q;
+    for (int p = proj->row_ptr[i]; p < proj->row_ptr[i + 1]; ++p) {
+      Ki[q] = proj->col_ind[p];
+      Kx[q++] = proj->val[p];
+    }
+    Ki[q] = static_cast<int>(n + i);
+    Kx[q++] = -1.0;
+  }
+  Kp[m + n] = q;
+
+  // Factor K.
+  LdlSymbolic(static_cast<int>(m + n), Kp.data(), Ki.data(), &proj->ldl);
+  if (LdlNumeric(Kp.data(), Ki.data(), Kx.data(), &proj->ldl) != 0) {
+    fprintf(stderr, "ERROR: LDL^T factorization of KKT matrix failed.\n");
+    delete proj;
+    return 0;
+  }
+  proj->rhs.resize(m + n);
+  proj->work.resize(m + n);
+
+  return proj;
+}
+
+// Returns a view of block b of the rows of memory-mapped A.
+template <typename T>
+gsl::matrix_const_view<T> MappedBlock(const Projector<MappedMatrix<T> > *proj,
+                                      size_t b) {
+  size_t i = b * proj->block_rows;
+  size_t rows = std::min(proj->block_rows, proj->m - i);
+  return gsl::matrix_const_view_array(proj->val + i * proj->n, rows, proj->n);
+}
+
+// Advises the kernel to start reading block b of memory-mapped A.
+template <typename T>
+void MappedPrefetch(const Projector<MappedMatrix<T> > *proj, size_t b) {
+  size_t i = b * proj->block_rows;
+  size_t rows = std::min(proj->block_rows, proj->m - i);
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const char *begin = reinterpret_cast<const char*>(proj->val + i * proj->n);
+  size_t offset = reinterpret_cast<size_t>(begin) % page;
+  size_t len = offset + rows * proj->n * sizeof(T);
+  madvise(const_cast<char*>(begin - offset), len, MADV_WILLNEED);
+}
+
+// Computes y = alpha * op(A) * x + beta * y for memory-mapped A in a single
+// pass over its blocks, in the direction given by proj->forward. The next
+// block is prefetched while the current one is processed.
+template <typename T>
+void MappedGemv(const Projector<MappedMatrix<T> > *proj,
+                CBLAS_TRANSPOSE_t trans, T alpha, const gsl::vector<T> *x,
+                T beta, gsl::vector<T> *y) {
+  const T kOne = static_cast<T>(1);
+  size_t num_blocks = (proj->m + proj->block_rows - 1) / proj->block_rows;
+  if (trans == CblasTrans)
+    gsl::vector_scale(y, beta);
+  for (size_t k = 0; k < num_blocks; ++k) {
+    size_t b = proj->forward ? k : num_blocks - 1 - k;
+    if (k + 1 < num_blocks)
+      MappedPrefetch(proj, proj->forward ? b + 1 : b - 1);
+    gsl::matrix_const_view<T> B = MappedBlock(proj, b);
+    size_t i = b * proj->block_rows;
+    size_t rows = B.matrix.size1;
+    if (trans == CblasNoTrans) {
+      gsl::vector_view<T> y_b = gsl::vector_subvector(y, i, rows);
+      gsl::blas_gemv(CblasNoTrans, alpha, &B.matrix, x, beta, &y_b.vector);
+    } else {
+      gsl::vector_const_view<T> x_b = gsl::vector_const_subvector(x, i, rows);
+      gsl::blas_gemv(CblasTrans, alpha, &B.matrix, &x_b.vector, kOne, y);
+    }
+  }
+  proj->forward = !proj->forward;
+}
+
+// Sets up the projection for memory-mapped A. See the dense version. A^TA is
+// accumulated over blocks of rows and AA^T over pairs of blocks, so that only
+// the Gram matrix and two blocks of A need to be in memory. Equilibration
+// and mixed precision are not supported and are ignored with a warning.
+template <typename T>
+Projector<MappedMatrix<T> > *ProjectorSetup(const MappedMatrix<T> &A_in,
+                                            size_t m, size_t n,
+                                            unsigned int equil_iter,
+                                            bool indirect,
+                                            unsigned int cg_max_iter,
+                                            bool mixed,
+                                            unsigned int /*refine_iter*/,
+                                            Choice explicit_inverse,
+                                            gsl::vector<T> * /*d*/,
+                                            gsl::vector<T> * /*e*/) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  if (equil_iter > 0)
+    fprintf(stderr, "WARNING: Equilibration is not supported for "
+            "memory-mapped A.\n");
+  if (mixed && !indirect)
+    fprintf(stderr, "WARNING: Mixed precision is not supported for "
+            "memory-mapped A.\n");
+  size_t min_dim = std::min(m, n);
+  Projector<MappedMatrix<T> > *proj = new Projector<MappedMatrix<T> >;
+  proj->m = m;
+  proj->n = n;
+  proj->block_rows = std::max(A_in.block_rows, static_cast<size_t>(1));
+  proj->val = A_in.val;
+  proj->forward = true;
+  proj->L = 0;
+  proj->AA = 0;
+  proj->P = 0;
+  proj->cg = 0;
+  size_t num_blocks = (m + proj->block_rows - 1) / proj->block_rows;
+
+  // Compute the preconditioner 1 / diag(I + A^TA).
+  if (indirect) {
+    proj->cg = CgAlloc<T>(m, n, cg_max_iter);
+    gsl::vector_set_all(proj->cg->diag_inv, kOne);
+    for (size_t b = 0; b < num_blocks; ++b) {
+      if (b + 1 < num_blocks)
+        MappedPrefetch(proj, b + 1);
+      gsl::matrix_const_view<T> B = MappedBlock(proj, b);
+      for (unsigned int i = 0; i < B.matrix.size1; ++i) {
+        for (unsigned int j = 0; j < n; ++j) {
+          T a_ij = gsl::matrix_get(&B.matrix, i, j);
+          *gsl::vector_ptr(proj->cg->diag_inv, j) += a_ij * a_ij;
+        }
+      }
+    }
+    for (unsigned int j = 0; j < n; ++j)
+      gsl::vector_set(proj->cg->diag_inv, j,
+                      kOne / gsl::vector_get(proj->cg->diag_inv, j));
+    return proj;
+  }
+
+  proj->AA = gsl::matrix_calloc<T>(min_dim, min_dim);
+  if (m >= n) {
+    for (size_t b = 0; b < num_blocks; ++b) {
+      if (b + 1 < num_blocks)
+        MappedPrefetch(proj, b + 1);
+      gsl::matrix_const_view<T> B = MappedBlock(proj, b);
+      gsl::blas_syrk(CblasLower, CblasTrans, kOne, &B.matrix, kOne, proj->AA);
+    }
+  } else {
+    for (size_t bi = 0; bi < num_blocks; ++bi) {
+      gsl::matrix_const_view<T> Bi = MappedBlock(proj, bi);
+      for (size_t bj = 0; bj <= bi; ++bj) {
+        gsl::matrix_const_view<T> Bj = MappedBlock(proj, bj);
+        gsl::matrix_view<T> C = gsl::matrix_submatrix(
+            proj->AA, bi * proj->block_rows, bj * proj->block_rows,
+            Bi.matrix.size1, Bj.matrix.size1);
+        if (bi == bj)
+          gsl::blas_syrk(CblasLower, CblasNoTrans, kOne, &Bi.matrix, kZero,
+                         &C.matrix);
+        else
+          gsl::blas_gemm(CblasNoTrans, CblasTrans, kOne, &Bi.matrix,
+                         &Bj.matrix, kZero, &C.matrix);
+      }
+    }
+  }
+  FactorGram<T>(m, n, explicit_inverse, &proj->AA, &proj->L, &proj->P);
+
+  return proj;
+}
+
+// Returns true if proj was set up for the matrix A.
+template <typename T>
+bool ProjectorMatches(const Projector<T*> *proj, const T *A) {
+  return proj->A_in == A;
+}
+
+template <typename T>
+bool ProjectorMatches(const Projector<CsrMatrix<T> > *proj,
+                      const CsrMatrix<T> &A) {
+  return proj->val_in == A.val && proj->row_ptr == A.row_ptr &&
+      proj->col_ind == A.col_ind;
+}
+
+template <typename T>
+bool ProjectorMatches(const Projector<MappedMatrix<T> > *proj,
+                      const MappedMatrix<T> &A) {
+  return proj->val == A.val;
+}
+
+// Computes y = alpha * op(A) * x + beta * y for dense A, in memory or
+// memory-mapped, and for sparse A.
+template <typename T>
+void Gemv(const Projector<T*> *proj, CBLAS_TRANSPOSE_t trans, T alpha,
+          const gsl::vector<T> *x, T beta, gsl::vector<T> *y) {
+  gsl::blas_gemv(trans, alpha, &proj->A.matrix, x, beta, y);
+}
+
+template <typename T>
+void Gemv(const Projector<MappedMatrix<T> > *proj, CBLAS_TRANSPOSE_t trans,
+          T alpha, const gsl::vector<T> *x, T beta, gsl::vector<T> *y) {
+  MappedGemv(proj, trans, alpha, x, beta, y);
+}
+
+template <typename T>
+void Gemv(const Projector<CsrMatrix<T> > *proj, CBLAS_TRANSPOSE_t trans,
+          T alpha, const gsl::vector<T> *x, T beta, gsl::vector<T> *y) {
+  if (trans == CblasNoTrans)
+    CsrGemv(proj->m, proj->row_ptr, proj->col_ind, proj->val.data(), alpha,
+            x, beta, y);
+  else
+    CsrGemv(proj->n, proj->col_ptr.data(), proj->row_ind.data(),
+            proj->val_t.data(), alpha, x, beta, y);
+}
+
+// Computes q = (I + A^TA) * p, using tmp (of length m) as workspace.
+template <typename T>
+void GramMult(const Projector<T*> *proj, const gsl::vector<T> *p,
+              gsl::vector<T> *q, gsl::vector<T> *tmp) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  Gemv(proj, CblasNoTrans, kOne, p, kZero, tmp);
+  gsl::vector_memcpy(q, p);
+  Gemv(proj, CblasTrans, kOne, tmp, kOne, q);
+}
+
+template <typename T>
+void GramMult(const Projector<MappedMatrix<T> > *proj,
+              const gsl::vector<T> *p, gsl::vector<T> *q,
+              gsl::vector<T> *tmp) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  Gemv(proj, CblasNoTrans, kOne, p, kZero, tmp);
+  gsl::vector_memcpy(q, p);
+  Gemv(proj, CblasTrans, kOne, tmp, kOne, q);
+}
+
+template <typename T>
+void GramMult(const Projector<CsrMatrix<T> > *proj, const gsl::vector<T> *p,
+              gsl::vector<T> *q, gsl::vector<T> *tmp) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  CsrGemv(proj->m, proj->row_ptr, proj->col_ind, proj->val.data(), kOne, p,
+          kZero, tmp);
+  gsl::vector_memcpy(q, p);
+  CsrGemv(proj->n, proj->col_ptr.data(), proj->row_ind.data(),
+          proj->val_t.data(), kOne, tmp, kOne, q);
+}
+
+// Solves (I + A^TA) * cg->x = cg->b by preconditioned conjugate gradient,
+// starting from the current value of cg->x. Stops when the residual is at
+// most tol and returns the number of iterations.
+template <typename T, typename P>
+unsigned int Pcg(const P *proj, CgWork<T> *cg, T tol) {
+  // r = b - (I + A^TA) * x.
+  GramMult(proj, cg->x, cg->r, cg->tmp);
+  gsl::vector_sub(cg->r, cg->b);
+  gsl::vector_scale(cg->r, -static_cast<T>(1));
+  if (gsl::blas_nrm2(cg->r) <= tol)
+    return 0;
+
+  gsl::vector_memcpy(cg->s, cg->r);
+  gsl::vector_mul(cg->s, cg->diag_inv);
+  gsl::vector_memcpy(cg->p, cg->s);
+  T rs = gsl::blas_dot(cg->r, cg->s);
+
+  unsigned int k;
+  for (k = 0; k < cg->max_iter; ++k) {
+    GramMult(proj, cg->p, cg->q, cg->tmp);
+    T step = rs / gsl::blas_dot(cg->p, cg->q);
+    gsl::blas_axpy(step, cg->p, cg->x);
+    gsl::blas_axpy(-step, cg->q, cg->r);
+    if (gsl::blas_nrm2(cg->r) <= tol)
+      return k + 1;
+
+    gsl::vector_memcpy(cg->s, cg->r);
+    gsl::vector_mul(cg->s, cg->diag_inv);
+    T rs_new = gsl::blas_dot(cg->r, cg->s);
+    gsl::vector_scale(cg->p, rs_new / rs);
+    gsl::vector_add(cg->p, cg->s);
+    rs = rs_new;
+  }
+  return k;
+}
+
+// Solves (I + A^TA) * x = b if A is skinny and (I + AA^T) * x = b if A is fat
+// in mixed precision, by a single precision triangular solve followed by
+// proj->refine_iter steps of iterative refinement. The residual of each step
+// is computed in precision T, using the single precision A^TA or AA^T, which
+// only costs min(m, n)^2 operations.
+template <typename T>
+void MixedSolve(Projector<T*> *proj, gsl::vector<T> *x) {
+  const T kOne = static_cast<T>(1);
+  gsl::vector_memcpy(proj->b, x);
+  gsl::vector_set_zero(x);
+  gsl::vector_memcpy(proj->r, proj->b);
+  for (unsigned int k = 0; k <= proj->refine_iter; ++k) {
+    if (k > 0) {
+      gsl::vector_memcpy(proj->r, proj->b);
+      gsl::vector_sub(proj->r, x);
+      MixedGemv(CblasNoTrans, -kOne, proj->AAf, x, kOne, proj->r);
+    }
+    for (unsigned int i = 0; i < proj->r->size; ++i)
+      gsl::vector_set(proj->Lr, i,
+                      static_cast<float>(gsl::vector_get(proj->r, i)));
+    gsl::linalg_cholesky_svx(proj->Lf, proj->Lr);
+    for (unsigned int i = 0; i < proj->r->size; ++i)
+      *gsl::vector_ptr(x, i) += gsl::vector_get(proj->Lr, i);
+  }
+}
+
+// Projects (xt, yt) onto the graph of dense A (in memory or memory-mapped)
+// with the factorization, its inverse or CG, storing the result in (x, y)
+// and subtracting it from (xt, yt). The tolerance cg_tol only applies to the
+// indirect projection.
+template <typename P, typename T>
+void ProjectDense(const P *proj, gsl::vector<T> *x, gsl::vector<T> *y,
+                  gsl::vector<T> *xt, gsl::vector<T> *yt, T cg_tol) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  if (proj->cg != 0) {
+    gsl::vector_memcpy(proj->cg->b, xt);
+    Gemv(proj, CblasTrans, kOne, yt, kOne, proj->cg->b);
+    Pcg(proj, proj->cg, cg_tol);
+    gsl::vector_memcpy(x, proj->cg->x);
+    Gemv(proj, CblasNoTrans, kOne, x, kZero, y);
+    gsl::vector_sub(yt, y);
+  } else if (proj->P != 0 && proj->m >= proj->n) {
+    // x = P * (xt + A^T * yt), using the first n entries of y as workspace.
+    gsl::vector_view<T> tmp = gsl::vector_subvector(y, 0, proj->n);
+    gsl::vector_memcpy(&tmp.vector, xt);
+    Gemv(proj, CblasTrans, kOne, yt, kOne, &tmp.vector);
+    gsl::blas_symv(CblasLower, kOne, proj->P, &tmp.vector, kZero, x);
+    Gemv(proj, CblasNoTrans, kOne, x, kZero, y);
+    gsl::vector_sub(yt, y);
+  } else if (proj->P != 0) {
+    // Since P * AA^T = I - P, y = P * (A * xt - yt) + yt, using the first m
+    // entries of x as workspace.
+    gsl::vector_view<T> tmp = gsl::vector_subvector(x, 0, proj->m);
+    Gemv(proj, CblasNoTrans, kOne, xt, kZero, &tmp.vector);
+    gsl::vector_sub(&tmp.vector, yt);
+    gsl::vector_memcpy(y, yt);
+    gsl::blas_symv(CblasLower, kOne, proj->P, &tmp.vector, kOne, y);
+    gsl::vector_sub(yt, y);
+    gsl::vector_memcpy(x, xt);
+    Gemv(proj, CblasTrans, kOne, yt, kOne, x);
+  } else if (proj->m >= proj->n) {
+    gsl::vector_memcpy(x, xt);
+    Gemv(proj, CblasTrans, kOne, yt, kOne, x);
+    gsl::linalg_cholesky_svx(proj->L, x);
+    Gemv(proj, CblasNoTrans, kOne, x, kZero, y);
+    gsl::vector_sub(yt, y);
+  } else {
+    Gemv(proj, CblasNoTrans, kOne, xt, kZero, y);
+    gsl::blas_symv(CblasLower, kOne, proj->AA, yt, kOne, y);
+    gsl::linalg_cholesky_svx(proj->L, y);
+    gsl::vector_sub(yt, y);
+    gsl::vector_memcpy(x, xt);
+    Gemv(proj, CblasTrans, kOne, yt, kOne, x);
+  }
+  gsl::vector_sub(xt, x);
+}
+
+// Projects (xt, yt) onto the graph of A, storing the result in (x, y) and
+// subtracting it from (xt, yt). The tolerance cg_tol only applies to the
+// indirect projection.
+template <typename T>
+void Project(Projector<T*> *proj, gsl::vector<T> *x, gsl::vector<T> *y,
+             gsl::vector<T> *xt, gsl::vector<T> *yt, T cg_tol) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  if (proj->Af == 0) {
+    ProjectDense(proj, x, y, xt, yt, cg_tol);
+    return;
+  }
+  if (proj->m >= proj->n) {
+    gsl::vector_memcpy(x, xt);
+    MixedGemv(CblasTrans, kOne, proj->Af, yt, kOne, x);
+    MixedSolve(proj, x);
+    MixedGemv(CblasNoTrans, kOne, proj->Af, x, kZero, y);
+    gsl::vector_sub(yt, y);
+  } else {
+    MixedGemv(CblasNoTrans, kOne, proj->Af, xt, kZero, y);
+    MixedGemv(CblasNoTrans, kOne, proj->AAf, yt, kOne, y);
+    MixedSolve(proj, y);
+    gsl::vector_sub(yt, y);
+    gsl::vector_memcpy(x, xt);
+    MixedGemv(CblasTrans, kOne, proj->Af, yt, kOne, x);
+  }
+  gsl::vector_sub(xt, x);
+}
+
+template <typename T>
+void Project(Projector<MappedMatrix<T> > *proj, gsl::vector<T> *x,
+             gsl::vector<T> *y, gsl::vector<T> *xt, gsl::vector<T> *yt,
+             T cg_tol) {
+  ProjectDense(proj, x, y, xt, yt, cg_tol);
+}
+
+// Solves K * [x; y] = [xt + A^T * yt; 0], which gives y = A * x, or the
+// equivalent system (I + A^TA) * x = xt + A^T * yt if the projection is
+// indirect.
+template <typename T>
+void Project(Projector<CsrMatrix<T> > *proj, gsl::vector<T> *x,
+             gsl::vector<T> *y, gsl::vector<T> *xt, gsl::vector<T> *yt,
+             T cg_tol) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  size_t m = proj->m;
+  size_t n = proj->n;
+  if (proj->cg != 0) {
+    gsl::vector_memcpy(proj->cg->b, xt);
+    CsrGemv(n, proj->col_ptr.data(), proj->row_ind.data(), proj->val_t.data(),
+            kOne, yt, kOne, proj->cg->b);
+    Pcg(proj, proj->cg, cg_tol);
+    gsl::vector_memcpy(x, proj->cg->x);
+    CsrGemv(m, proj->row_ptr, proj->col_ind, proj->val.data(), kOne, x, kZero,
+            y);
+  } else {
+    #pragma omp parallel for schedule(static) if (n >= SOLVER_OMP_MIN_LEN)
+    for (unsigned int j = 0; j < n; ++j) {
+      double sum = gsl::vector_get(xt, j);
+      for (int p = proj->col_ptr[j]; p < proj->col_ptr[j + 1]; ++p)
+        sum += proj->val_t[p] * gsl::vector_get(yt, proj->row_ind[p]);
+      proj->rhs[j] = sum;
+    }
+    std::fill(proj->rhs.begin() + n, proj->rhs.end(), 0.0);
+    LdlSolve(proj->ldl, proj->rhs.data(), proj->work.data());
+    for (unsigned int j = 0; j < n; ++j)
+      gsl::vector_set(x, j, static_cast<T>(proj->rhs[j]));
+    for (unsigned int i = 0; i < m; ++i)
+      gsl::vector_set(y, i, static_cast<T>(proj->rhs[n + i]));
+  }
+  gsl::vector_sub(xt, x);
+  gsl::vector_sub(yt, y);
+}
+
+template <typename T>
+void ProjectorFree(Projector<T*> *proj) {
+  if (proj->Ae != 0)
+    gsl::matrix_free(proj->Ae);
+  if (proj->L != 0)
+    gsl::matrix_free(proj->L);
+  if (proj->AA != 0)
+    gsl::matrix_free(proj->AA);
+  if (proj->P != 0)
+    gsl::matrix_free(proj->P);
+  if (proj->Af != 0) {
+    gsl::matrix_free(proj->Af);
+    gsl::matrix_free(proj->AAf);
+    gsl::matrix_free(proj->Lf);
+    gsl::vector_free(proj->b);
+    gsl::vector_free(proj->r);
+    gsl::vector_free(proj->Lr);
+  }
+  CgFree(proj->cg);
+  delete proj;
+}
+
+template <typename T>
+void ProjectorFree(Projector<CsrMatrix<T> > *proj) {
+  CgFree(proj->cg);
+  delete proj;
+}
+
+template <typename T>
+void ProjectorFree(Projector<MappedMatrix<T> > *proj) {
+  if (proj->L != 0)
+    gsl::matrix_free(proj->L);
+  if (proj->AA != 0)
+    gsl::matrix_free(proj->AA);
+  if (proj->P != 0)
+    gsl::matrix_free(proj->P);
+  CgFree(proj->cg);
+  delete proj;
+}
+}  // namespace
+
+namespace {
+// Computes z12 = Prox{h}(z - zt) and the dual update
+// zt += alpha * z12 + (1 - alpha) * z for the functions h, in a single pass
+// over (z, zt, z12). For z = (x, y), h = (g, f). The vectors are processed
+// in chunks of kProxChunk elements, so that z - zt stays in cache between
+// the two steps. The loop runs over both parts of z at once, so that each
+// thread touches about the same range of (z, zt, z12) as in ComputeNorms()
+// and at initialization.
+template <typename T>
+void ProxDualUpdate(const FunctionVec<T> &h, T rho, T alpha, const T *z,
+                    T *zt, T *z12) {
+  const T kOne = static_cast<T>(1);
+  size_t len = h.size;
+  #pragma omp parallel for schedule(static) if (len >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < len; i += kProxChunk) {
+    size_t len_i = std::min<size_t>(kProxChunk, len - i);
+    T v[kProxChunk];
+    for (unsigned int k = 0; k < len_i; ++k)
+      v[k] = z[i + k] - zt[i + k];
+    ProxEvalChunk(h, i, len_i, rho, v, z12 + i);
+    for (unsigned int k = 0; k < len_i; ++k)
+      zt[i + k] += alpha * z12[i + k] + (kOne - alpha) * z[i + k];
+  }
+}
+
+// Norms of the iterates and residuals after one ADMM iteration, where z is
+// the new and z_prev the previous iterate.
+template <typename T>
+struct IterNorms {
+  T z, zt, z12, r, s;
+};
+
+// Computes all quantities in IterNorms in a single pass over vectors of
+// length len. The dual residual s is not multiplied by rho.
+template <typename T>
+IterNorms<T> ComputeNorms(size_t len, const T *z, const T *z_prev,
+                          const T *zt, const T *z12) {
+  T sq_z = 0, sq_zt = 0, sq_z12 = 0, sq_r = 0, sq_s = 0;
+  #pragma omp parallel for schedule(static) \
+      reduction(+:sq_z, sq_zt, sq_z12, sq_r, sq_s) \
+      if (len >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < len; ++i) {
+    T r_i = z12[i] - z[i];
+    T s_i = z[i] - z_prev[i];
+    sq_z += z[i] * z[i];
+    sq_zt += zt[i] * zt[i];
+    sq_z12 += z12[i] * z12[i];
+    sq_r += r_i * r_i;
+    sq_s += s_i * s_i;
+  }
+  IterNorms<T> nrm;
+  nrm.z = std::sqrt(sq_z);
+  nrm.zt = std::sqrt(sq_zt);
+  nrm.z12 = std::sqrt(sq_z12);
+  nrm.r = std::sqrt(sq_r);
+  nrm.s = std::sqrt(sq_s);
+  return nrm;
+}
+}  // namespace
+
+namespace {
+// Sets the number of OpenMP threads to num_threads, unless it is 0, and
+// returns the previous number, which can be restored by a second call.
+int SetNumThreads(int num_threads) {
+#ifdef _OPENMP
+  int prev = omp_get_max_threads();
+  if (num_threads > 0)
+    omp_set_num_threads(num_threads);
+  return prev;
+#else
+  return num_threads;
+#endif
+}
+}  // namespace
+
+template <typename T, typename M>
+struct AdmmWork {
+  size_t m, n;
+
+  // ADMM iterates. The buffers z and z_prev are swapped by Solver() in every
+  // iteration, so either may hold the current iterate.
+  gsl::vector<T> *z, *zt, *z12, *z_prev;
+
+  // Row and column scaling of A, which are all ones unless A was
+  // equilibrated.
+  bool equil;
+  gsl::vector<T> *d, *e;
+
+  // Projection onto the graph of A.
+  Projector<M> *proj;
+
+  // Anderson acceleration memory (allocated on first use).
+  Anderson<T> *aa;
+};
+
+template <typename T, typename M>
+AdmmWork<T, M> *SolverSetup(const AdmmData<T, M> &admm_data) {
+  size_t n = admm_data.n;
+  size_t m = admm_data.m;
+  int prev_threads = SetNumThreads(static_cast<int>(admm_data.num_threads));
+
+  AdmmWork<T, M> *work = new AdmmWork<T, M>;
+  work->m = m;
+  work->n = n;
+  work->aa = 0;
+  work->equil = admm_data.equil_iter > 0;
+  work->d = gsl::vector_alloc<T>(m);
+  work->e = gsl::vector_alloc<T>(n);
+  gsl::vector_set_all(work->d, static_cast<T>(1));
+  gsl::vector_set_all(work->e, static_cast<T>(1));
+
+  // Allocate data for ADMM variables. The vectors are zeroed in parallel, so
+  // that on NUMA systems their pages are placed on the nodes of the threads
+  // that operate on them during the iteration (first-touch policy).
+  work->z = gsl::vector_alloc<T>(m + n);
+  work->zt = gsl::vector_alloc<T>(m + n);
+  work->z12 = gsl::vector_alloc<T>(m + n);
+  work->z_prev = gsl::vector_alloc<T>(m + n);
+  gsl::vector_set_zero(work->z);
+  gsl::vector_set_zero(work->zt);
+  gsl::vector_set_zero(work->z12);
+  gsl::vector_set_zero(work->z_prev);
+
+  // Equilibrate and factor A.
+  work->proj = ProjectorSetup(admm_data.A, m, n, admm_data.equil_iter,
+                              admm_data.indirect, admm_data.cg_max_iter,
+                              admm_data.mixed_precision,
+                              admm_data.refine_iter,
+                              admm_data.explicit_inverse, work->d, work->e);
+  if (work->proj == 0) {
+    SolverFree(work);
+    work = 0;
+  }
+
+  SetNumThreads(prev_threads);
+  return work;
+}
+
+template <typename T, typename M>
+void SolverFree(AdmmWork<T, M> *work) {
+  if (work == 0)
+    return;
+  if (work->proj != 0)
+    ProjectorFree(work->proj);
+  gsl::vector_free(work->z);
+  gsl::vector_free(work->zt);
+  gsl::vector_free(work->z12);
+  gsl::vector_free(work->z_prev);
+  gsl::vector_free(work->d);
+  gsl::vector_free(work->e);
+  AndersonFree(work->aa);
+  delete work;
+}
+
+namespace {
+// Projects each row of Zt onto the graph of A as in Project(), where the
+// corresponding rows of Z receive the projections and cg_tol holds the CG
+// tolerance of each row. With the indirect projection, each row is warm
+// started from (and leaves its solution in) the same row of X0, since the
+// rows generally belong to unrelated problems.
+template <typename P, typename T>
+void ProjectRows(P *proj, gsl::matrix<T> *Z, gsl::matrix<T> *Zt,
+                 gsl::matrix<T> *X0, const T *cg_tol) {
+  size_t m = proj->m;
+  size_t n = proj->n;
+  gsl::vector<T> *cg_x = proj->cg != 0 ? proj->cg->x : 0;
+  for (unsigned int i = 0; i < Z->size1; ++i) {
+    gsl::vector_view<T> z = gsl::matrix_row(Z, i);
+    gsl::vector_view<T> zt = gsl::matrix_row(Zt, i);
+    gsl::vector_view<T> x = gsl::vector_subvector(&z.vector, 0, n);
+    gsl::vector_view<T> y = gsl::vector_subvector(&z.vector, n, m);
+    gsl::vector_view<T> xt = gsl::vector_subvector(&zt.vector, 0, n);
+    gsl::vector_view<T> yt = gsl::vector_subvector(&zt.vector, n, m);
+    if (cg_x != 0) {
+      gsl::vector_view<T> x0 = gsl::matrix_row(X0, i);
+      proj->cg->x = &x0.vector;
+      Project(proj, &x.vector, &y.vector, &xt.vector, &yt.vector, cg_tol[i]);
+      proj->cg->x = cg_x;
+    } else {
+      Project(proj, &x.vector, &y.vector, &xt.vector, &yt.vector, cg_tol[i]);
+    }
+  }
+}
+
+// Batched version of Project() for dense A. With a Cholesky factor, all rows
+// are projected at once by matrix-matrix products and triangular solves with
+// multiple right-hand sides, such that A and L are only read once.
+template <typename T>
+void ProjectBatch(Projector<T*> *proj, gsl::matrix<T> *Z, gsl::matrix<T> *Zt,
+                  gsl::matrix<T> *X0, const T *cg_tol) {
+  const T kOne = static_cast<T>(1);
+  const T kZero = static_cast<T>(0);
+  if (proj->L == 0 && proj->P == 0) {
+    ProjectRows(proj, Z, Zt, X0, cg_tol);
+    return;
+  }
+  size_t k = Z->size1;
+  size_t m = proj->m;
+  size_t n = proj->n;
+  const gsl::matrix<T> *A = &proj->A.matrix;
+  gsl::matrix_view<T> X = gsl::matrix_submatrix(Z, 0, 0, k, n);
+  gsl::matrix_view<T> Y = gsl::matrix_submatrix(Z, 0, n, k, m);
+  gsl::matrix_view<T> Xt = gsl::matrix_submatrix(Zt, 0, 0, k, n);
+  gsl::matrix_view<T> Yt = gsl::matrix_submatrix(Zt, 0, n, k, m);
+
+  // The rows of X and Y are the transposes of x and y in Project(), so
+  // (I + A^TA)^-1 is applied from the right as (L^T)^-1 followed by L^-1, or
+  // as P. The explicit versions use part of X or Y as workspace as in
+  // Project().
+  if (proj->P != 0 && m >= n) {
+    gsl::matrix_view<T> Tmp = gsl::matrix_submatrix(Z, 0, n, k, n);
+    gsl::matrix_memcpy(&Tmp.matrix, &Xt.matrix);
+    gsl::blas_gemm(CblasNoTrans, CblasNoTrans, kOne, &Yt.matrix, A, kOne,
+                   &Tmp.matrix);
+    gsl::blas_symm(CblasRight, CblasLower, kOne, proj->P, &Tmp.matrix, kZero,
+                   &X.matrix);
+    gsl::blas_gemm(CblasNoTrans, CblasTrans, kOne, &X.matrix, A, kZero,
+                   &Y.matrix);
+    gsl::matrix_sub(&Yt.matrix, &Y.matrix);
+  } else if (proj->P != 0) {
+    gsl::matrix_view<T> Tmp = gsl::matrix_submatrix(Z, 0, 0, k, m);
+    gsl::blas_gemm(CblasNoTrans, CblasTrans, kOne, &Xt.matrix, A, kZero,
+                   &Tmp.matrix);
+    gsl::matrix_sub(&Tmp.matrix, &Yt.matrix);
+    gsl::matrix_memcpy(&Y.matrix, &Yt.matrix);
+    gsl::blas_symm(CblasRight, CblasLower, kOne, proj->P, &Tmp.matrix, kOne,
+                   &Y.matrix);
+    gsl::matrix_sub(&Yt.matrix, &Y.matrix);
+    gsl::matrix_memcpy(&X.matrix, &Xt.matrix);
+    gsl::blas_gemm(CblasNoTrans, CblasNoTrans, kOne, &Yt.matrix, A, kOne,
+                   &X.matrix);
+  } else if (m >= n) {
+    gsl::matrix_memcpy(&X.matrix, &Xt.matrix);
+    gsl::blas_gemm(CblasNoTrans, CblasNoTrans, kOne, &Yt.matrix, A, kOne,
+                   &X.matrix);
+    gsl::blas_trsm(CblasRight, CblasLower, CblasTrans, CblasNonUnit, kOne,
+                   proj->L, &X.matrix);
+    gsl::blas_trsm(CblasRight, CblasLower, CblasNoTrans, CblasNonUnit, kOne,
+                   proj->L, &X.matrix);
+    gsl::blas_gemm(CblasNoTrans, CblasTrans, kOne, &X.matrix, A, kZero,
+                   &Y.matrix);
+    gsl::matrix_sub(&Yt.matrix, &Y.matrix);
+  } else {
+    gsl::blas_gemm(CblasNoTrans, CblasTrans, kOne, &Xt.matrix, A, kZero,
+                   &Y.matrix);
+    gsl::blas_symm(CblasRight, CblasLower, kOne, proj->AA, &Yt.matrix, kOne,
+                   &Y.matrix);
+    gsl::blas_trsm(CblasRight, CblasLower, CblasTrans, CblasNonUnit, kOne,
+                   proj->L, &Y.matrix);
+    gsl::blas_trsm(CblasRight, CblasLower, CblasNoTrans, CblasNonUnit, kOne,
+                   proj->L, &Y.matrix);
+    gsl::matrix_sub(&Yt.matrix, &Y.matrix);
+    gsl::matrix_memcpy(&X.matrix, &Xt.matrix);
+    gsl::blas_gemm(CblasNoTrans, CblasNoTrans, kOne, &Yt.matrix, A, kOne,
+                   &X.matrix);
+  }
+  gsl::matrix_sub(&Xt.matrix, &X.matrix);
+}
+
+template <typename T>
+void ProjectBatch(Projector<CsrMatrix<T> > *proj, gsl::matrix<T> *Z,
+                  gsl::matrix<T> *Zt, gsl::matrix<T> *X0, const T *cg_tol) {
+  ProjectRows(proj, Z, Zt, X0, cg_tol);
+}
+
+// Exchanges rows i and j of A.
+template <typename T>
+void SwapRows(gsl::matrix<T> *A, size_t i, size_t j) {
+  T *a_i = gsl::matrix_ptr(A, i, 0);
+  std::swap_ranges(a_i, a_i + A->size2, gsl::matrix_ptr(A, j, 0));
+}
+
+template <typename T>
+void ProjectBatch(Projector<MappedMatrix<T> > *proj, gsl::matrix<T> *Z,
+                  gsl::matrix<T> *Zt, gsl::matrix<T> *X0, const T *cg_tol) {
+  ProjectRows(proj, Z, Zt, X0, cg_tol);
+}
+
+// State of the ADMM iteration for one problem, such that the same code
+// drives Solver() and the lockstep iterations of SolverBatch(). The vectors
+// z, zt, z12 and z_prev have length m + n, and z and z_prev are swapped after
+// each projection.
+template <typename T, typename M>
+struct AdmmState {
+  AdmmData<T, M> *data;
+  const gsl::vector<T> *d, *e;
+  size_t m, n;
+
+  // The functions h = (g, f) of z = (x, y), rewritten for the equilibrated
+  // problem if A was equilibrated.
+  FunctionVec<T> h;
+
+  gsl::vector<T> *z, *zt, *z12, *z_prev;
+  Anderson<T> *aa;
+
+  T rho, cg_tol, sqrtn_atol;
+
+  // Iteration of the next convergence check, and iteration and distance to
+  // convergence (the largest ratio of residual to tolerance) at the last one.
+  unsigned int interval, next_check, last_check;
+  T last_gap;
+};
+
+// Initializes the state for admm_data, either from zero or from the warm
+// start. aa may be null.
+template <typename T, typename M>
+void StateInit(AdmmData<T, M> *admm_data, const AdmmWork<T, M> *work,
+               gsl::vector<T> *z, gsl::vector<T> *zt, gsl::vector<T> *z12,
+               gsl::vector<T> *z_prev, Anderson<T> *aa,
+               AdmmState<T, M> *st) {
+  size_t m = admm_data->m;
+  size_t n = admm_data->n;
+  const gsl::vector<T> *d = work->d;
+  const gsl::vector<T> *e = work->e;
+  st->data = admm_data;
+  st->d = d;
+  st->e = e;
+  st->m = m;
+  st->n = n;
+  st->z = z;
+  st->zt = zt;
+  st->z12 = z12;
+  st->z_prev = z_prev;
+  st->aa = aa;
+
+  // Gather g and f, rewritten for the equilibrated problem if necessary.
+  if (admm_data->f.empty() || admm_data->g.empty()) {
+    FunctionVec<T> f_tmp, g_tmp;
+    st->h.Assign(Functions(admm_data->g, admm_data->g_vec, &g_tmp),
+                 Functions(admm_data->f, admm_data->f_vec, &f_tmp));
+  } else {
+    st->h.Assign(admm_data->g, admm_data->f);
+  }
+  if (work->equil)
+    ScaleFunctions(d, e, &st->h);
+
+  // Create views for x and y components.
+  gsl::vector_view<T> x = gsl::vector_subvector(z, 0, n);
+  gsl::vector_view<T> y = gsl::vector_subvector(z, n, m);
+  gsl::vector_view<T> xt = gsl::vector_subvector(zt, 0, n);
+  gsl::vector_view<T> yt = gsl::vector_subvector(zt, n, m);
+
+  // Initialize ADMM variables, either from zero or from the warm start.
+  gsl::vector_set_zero(z);
+  gsl::vector_set_zero(zt);
+  gsl::vector_set_zero(z12);
+  gsl::vector_set_zero(z_prev);
+  if (admm_data->warm_start) {
+    for (unsigned int i = 0; i < m && admm_data->y != 0; ++i)
+      gsl::vector_set(&y.vector, i, admm_data->y[i] * gsl::vector_get(d, i));
+    for (unsigned int i = 0; i < n && admm_data->x != 0; ++i)
+      gsl::vector_set(&x.vector, i, admm_data->x[i] / gsl::vector_get(e, i));
+    for (unsigned int i = 0; i < m && admm_data->yt != 0; ++i)
+      gsl::vector_set(&yt.vector, i, admm_data->yt[i] / gsl::vector_get(d, i));
+    for (unsigned int i = 0; i < n && admm_data->xt != 0; ++i)
+      gsl::vector_set(&xt.vector, i, admm_data->xt[i] * gsl::vector_get(e, i));
+  }
+  if (aa != 0)
+    AndersonReset(aa);
 
   // Signal start of execution.
   if (!admm_data->quiet)
     printf("%4s %12s %10s %10s %10s %10s\n",
            "#", "r norm", "eps_pri", "s norm", "eps_dual", "objective");
 
-  double sqrtn_atol = sqrt(static_cast<double>(n)) * admm_data->abs_tol;
+  st->sqrtn_atol = std::sqrt(static_cast<T>(n)) * admm_data->abs_tol;
+  st->rho = admm_data->rho;
+  st->cg_tol = static_cast<T>(0);
+  st->interval = 1;
+  st->next_check = 0;
+  st->last_check = 0;
+  st->last_gap = static_cast<T>(0);
+}
+
+// Evaluates the proximal operators and updates the dual variables in
+// iteration k, leaving zt ready for the projection. With over-relaxation,
+// the projection is applied to alpha * z12 + (1 - alpha) * z + zt.
+template <typename T, typename M>
+void StateProx(AdmmState<T, M> *st, unsigned int k) {
+  // Store input to the fixed-point map for Anderson acceleration.
+  if (st->aa != 0)
+    AndersonStack<T>(st->z, st->zt, st->aa->u);
+
+  ProxDualUpdate(st->h, st->rho, st->data->alpha, st->z->data, st->zt->data,
+                 st->z12->data);
+  if (k == 0)
+    st->cg_tol = st->data->cg_tol * gsl::blas_nrm2(st->zt);
+}
+
+// Completes iteration k after the projection. Checks for convergence,
+// adapts rho and applies Anderson acceleration. Returns true if the
+// stopping criteria are met.
+template <typename T, typename M>
+bool StateUpdate(AdmmState<T, M> *st, unsigned int k) {
+  const AdmmData<T, M> *admm_data = st->data;
+  gsl::vector<T> *z = st->z;
+  gsl::vector<T> *zt = st->zt;
+  T rho = st->rho;
+
+  // Residuals are only computed at scheduled checks, at iterations that
+  // are printed or adapt rho, and at the last iteration.
+  bool update_rho = admm_data->adaptive_rho &&
+      k < admm_data->rho_max_iter &&
+      (k + 1) % std::max(admm_data->rho_interval, 1u) == 0;
+  if (k < st->next_check && k + 1 < admm_data->max_iter && !update_rho &&
+      (admm_data->quiet || k % 10 != 0)) {
+    if (st->aa != 0)
+      AndersonStep(st->aa, admm_data->anderson_type1,
+                   admm_data->anderson_safeguard, admm_data->anderson_reg,
+                   z, zt);
+    return false;
+  }
+
+  // Compute primal and dual tolerances, and ||r^k||_2 and ||s^k||_2.
+  IterNorms<T> nrm = ComputeNorms(st->m + st->n, z->data, st->z_prev->data,
+                                  zt->data, st->z12->data);
+  T eps_pri = st->sqrtn_atol + admm_data->rel_tol * std::max(nrm.z12, nrm.z);
+  T eps_dual = st->sqrtn_atol + admm_data->rel_tol * rho * nrm.zt;
+  T nrm_r = nrm.r;
+  T nrm_s = rho * nrm.s;
+
+  // Evaluate stopping criteria.
+  bool converged = nrm_r <= eps_pri && nrm_s <= eps_dual;
+  if (!admm_data->quiet && (k % 10 == 0 || converged)) {
+    T obj = FuncEval(st->h, z->data);
+    printf("%4d :  %.3e  %.3e  %.3e  %.3e  %.3e\n",
+           k, nrm_r, eps_pri, nrm_s, eps_dual, obj);
+  }
+
+  if (converged)
+    return true;
+
+  // Schedule the next check. In the adaptive case, the interval at most
+  // doubles from one check to the next. The number of iterations left is
+  // estimated from the rate at which the gap decreased since the last
+  // check, and the next check is placed no further than halfway there.
+  unsigned int check_interval = std::max(admm_data->check_interval, 1u);
+  T gap = std::max(nrm_r / eps_pri, nrm_s / eps_dual);
+  if (!admm_data->adaptive_check) {
+    st->interval = check_interval;
+  } else {
+    st->interval = std::min(2 * st->interval, check_interval);
+    if (k > st->last_check && gap < st->last_gap) {
+      T rate = std::log(st->last_gap / gap) /
+          static_cast<T>(k - st->last_check);
+      T iter_left = std::log(gap) / rate;
+      if (iter_left < static_cast<T>(2 * st->interval))
+        st->interval = std::max(static_cast<unsigned int>(iter_left / 2), 1u);
+    }
+  }
+  st->next_check = k + st->interval;
+  st->last_check = k;
+  st->last_gap = gap;
+
+  // Tighten the CG tolerance along with the residuals, but not beyond the
+  // accuracy required by the stopping criteria.
+  st->cg_tol = admm_data->cg_tol * std::max(std::min(nrm_r, nrm_s / rho),
+                                            std::min(eps_pri, eps_dual / rho));
+
+  // Rebalance primal and dual residuals. Since the projection does not
+  // depend on rho, only the scaled dual variable zt needs to be updated.
+  if (update_rho) {
+    T rho_new = rho;
+    if (nrm_r > admm_data->rho_mu * nrm_s)
+      rho_new = std::min(rho * admm_data->rho_tau, admm_data->rho_max);
+    else if (nrm_s > admm_data->rho_mu * nrm_r)
+      rho_new = std::max(rho / admm_data->rho_tau, admm_data->rho_min);
+    if (rho_new != rho) {
+      gsl::vector_scale(zt, rho / rho_new);
+      st->rho = rho_new;
+      if (st->aa != 0)
+        AndersonReset(st->aa);
+    }
+  }
+
+  // Extrapolate (z, zt) from previous iterates.
+  if (st->aa != 0)
+    AndersonStep(st->aa, admm_data->anderson_type1,
+                 admm_data->anderson_safeguard, admm_data->anderson_reg, z, zt);
+  return false;
+}
+
+// Copies the current iterate to the output of the problem.
+template <typename T, typename M>
+void StateFinish(const AdmmState<T, M> *st) {
+  AdmmData<T, M> *admm_data = st->data;
+  size_t m = st->m;
+  size_t n = st->n;
+  const T *x = st->z->data;
+  const T *y = st->z->data + n;
+  const T *xt = st->zt->data;
+  const T *yt = st->zt->data + n;
+  for (unsigned int i = 0; i < m && admm_data->y != 0; ++i)
+    admm_data->y[i] = y[i] / gsl::vector_get(st->d, i);
+  for (unsigned int i = 0; i < n && admm_data->x != 0; ++i)
+    admm_data->x[i] = x[i] * gsl::vector_get(st->e, i);
+  for (unsigned int i = 0; i < m && admm_data->yt != 0; ++i)
+    admm_data->yt[i] = yt[i] * gsl::vector_get(st->d, i);
+  for (unsigned int i = 0; i < n && admm_data->xt != 0; ++i)
+    admm_data->xt[i] = xt[i] / gsl::vector_get(st->e, i);
+  admm_data->rho = st->rho;
+}
+}  // namespace
+
+template <typename T, typename M>
+int Solver(AdmmWork<T, M> *work, AdmmData<T, M> *admm_data) {
+  // Extract values from admm_data
+  size_t n = admm_data->n;
+  size_t m = admm_data->m;
+
+  if (work == 0 || work->m != m || work->n != n ||
+      !ProjectorMatches(work->proj, admm_data->A)) {
+    fprintf(stderr, "ERROR: AdmmWork was not set up for this AdmmData.\n");
+    return 1;
+  }
+  if (!FunctionsMatch(*admm_data)) {
+    fprintf(stderr, "ERROR: f and g do not match the dimensions of A.\n");
+    return 1;
+  }
+  int prev_threads = SetNumThreads(static_cast<int>(admm_data->num_threads));
+
+  // Set up Anderson acceleration.
+  Anderson<T> *aa = 0;
+  if (admm_data->anderson_mem > 0) {
+    if (work->aa == 0 || work->aa->mem != admm_data->anderson_mem) {
+      AndersonFree(work->aa);
+      work->aa = AndersonAlloc<T>(admm_data->anderson_mem, 2 * (m + n));
+    }
+    aa = work->aa;
+  }
+
+  AdmmState<T, M> st;
+  StateInit(admm_data, work, work->z, work->zt, work->z12, work->z_prev, aa,
+            &st);
+
+  // Create views for the dual variables.
+  gsl::vector_view<T> xt = gsl::vector_subvector(st.zt, 0, n);
+  gsl::vector_view<T> yt = gsl::vector_subvector(st.zt, n, m);
 
   for (unsigned int k = 0; k < admm_data->max_iter; ++k) {
-    // Evaluate Proximal Operators
-    gsl_vector_sub(&x.vector, &xt.vector);
-    gsl_vector_sub(&y.vector, &yt.vector);
-    ProxEval(admm_data->g, admm_data->rho, x.vector.data, x12.vector.data);
-    ProxEval(admm_data->f, admm_data->rho, y.vector.data, y12.vector.data);
-
-    // Project and Update Dual Variables
-    gsl_vector_add(&xt.vector, &x12.vector);
-    gsl_vector_add(&yt.vector, &y12.vector);
-    if (is_skinny) {
-      gsl_vector_memcpy(&x.vector, &xt.vector);
-      gsl_blas_dgemv(CblasTrans, 1.0, &A.matrix, &yt.vector, 1.0, &x.vector);
-      gsl_linalg_cholesky_svx(L, &x.vector);
-      gsl_blas_dgemv(CblasNoTrans, 1.0, &A.matrix, &x.vector, 0.0, &y.vector);
-      gsl_vector_sub(&yt.vector, &y.vector);
-    } else {
-      gsl_blas_dgemv(CblasNoTrans, 1.0, &A.matrix, &xt.vector, 0.0, &y.vector);
-      gsl_blas_dsymv(CblasLower, 1.0, AA, &yt.vector, 1.0, &y.vector);
-      gsl_linalg_cholesky_svx(L, &y.vector);
-      gsl_vector_sub(&yt.vector, &y.vector);
-      gsl_vector_memcpy(&x.vector, &xt.vector);
-      gsl_blas_dgemv(CblasTrans, 1.0, &A.matrix, &yt.vector, 1.0, &x.vector);
-    }
-    gsl_vector_sub(&xt.vector, &x.vector);
-
-    // Compute primal and dual tolerances.
-    double nrm_z = gsl_blas_dnrm2(z);
-    double nrm_zt = gsl_blas_dnrm2(zt);
-    double nrm_z12 = gsl_blas_dnrm2(z12);
-    double eps_pri = sqrtn_atol + admm_data->rel_tol * std::max(nrm_z12, nrm_z);
-    double eps_dual = sqrtn_atol + admm_data->rel_tol * admm_data->rho * nrm_zt;
-
-    // Compute ||r^k||_2 and ||s^k||_2.
-    gsl_vector_sub(z12, z);
-    gsl_vector_sub(z_prev, z);
-    double nrm_r = gsl_blas_dnrm2(z12);
-    double nrm_s = admm_data->rho * gsl_blas_dnrm2(z_prev);
-
-    // Evaluate stopping criteria.
-    bool converged = nrm_r <= eps_pri && nrm_s <= eps_dual;
-    if (!admm_data->quiet && (k % 10 == 0 || converged)) {
-      double obj = FuncEval(admm_data->f, y.vector.data) +
-          FuncEval(admm_data->g, x.vector.data);
-      printf("%4d :  %.3e  %.3e  %.3e  %.3e  %.3e\n",
-             k, nrm_r, eps_pri, nrm_s, eps_dual, obj);
-    }
-
-    if (converged)
-      break;
+    StateProx(&st, k);
 
-    // Make copy of z.
-    gsl_vector_memcpy(z_prev, z);
+    // Project into the buffer of the previous iterate, which is no longer
+    // needed, and swap buffers such that z holds the new iterate.
+    gsl::vector_view<T> x = gsl::vector_subvector(st.z_prev, 0, n);
+    gsl::vector_view<T> y = gsl::vector_subvector(st.z_prev, n, m);
+    Project(work->proj, &x.vector, &y.vector, &xt.vector, &yt.vector,
+            st.cg_tol);
+    std::swap(st.z, st.z_prev);
+
+    if (StateUpdate(&st, k))
+      break;
   }
 
   // Copy results to output.
-  for (unsigned int i = 0; i < m && admm_data->y != 0; ++i)
-    admm_data->y[i] = gsl_vector_get(&y.vector, i);
+  StateFinish(&st);
+
+  SetNumThreads(prev_threads);
+  return 0;
+}
+
+template <typename T, typename M>
+int SolverBatch(AdmmWork<T, M> *work,
+                const std::vector<AdmmData<T, M>*> &admm_data) {
+  size_t num = admm_data.size();
+  if (num == 0)
+    return 0;
+  if (work == 0) {
+    fprintf(stderr, "ERROR: AdmmWork was not set up for this AdmmData.\n");
+    return 1;
+  }
+  size_t m = work->m;
+  size_t n = work->n;
+  unsigned int max_iter = 0;
+  for (unsigned int j = 0; j < num; ++j) {
+    if (admm_data[j]->m != m || admm_data[j]->n != n ||
+        !ProjectorMatches(work->proj, admm_data[j]->A)) {
+      fprintf(stderr, "ERROR: AdmmWork was not set up for this AdmmData.\n");
+      return 1;
+    }
+    if (!FunctionsMatch(*admm_data[j])) {
+      fprintf(stderr, "ERROR: f and g do not match the dimensions of A.\n");
+      return 1;
+    }
+    max_iter = std::max(max_iter, admm_data[j]->max_iter);
+  }
+  int prev_threads =
+      SetNumThreads(static_cast<int>(admm_data[0]->num_threads));
+
+  // The iterates of problem j are initially stored in row j of each matrix,
+  // and are zeroed (first touched) by StateInit(). With the indirect
+  // projection, X0 holds the CG warm start of each row, starting from that of
+  // the workspace.
+  gsl::matrix<T> *Z = gsl::matrix_alloc<T>(num, m + n);
+  gsl::matrix<T> *Zt = gsl::matrix_alloc<T>(num, m + n);
+  gsl::matrix<T> *Z12 = gsl::matrix_alloc<T>(num, m + n);
+  gsl::matrix<T> *Z_prev = gsl::matrix_alloc<T>(num, m + n);
+  gsl::matrix<T> *X0 = 0;
+  if (work->proj->cg != 0) {
+    X0 = gsl::matrix_alloc<T>(num, n);
+    for (unsigned int j = 0; j < num; ++j) {
+      gsl::vector_view<T> x0 = gsl::matrix_row(X0, j);
+      gsl::vector_memcpy(&x0.vector, work->proj->cg->x);
+    }
+  }
+  std::vector<gsl::vector_view<T> > rows;
+  rows.reserve(4 * num);
+  std::vector<AdmmState<T, M> > st(num);
+  std::vector<Anderson<T>*> aa(num, static_cast<Anderson<T>*>(0));
+  std::vector<unsigned int> order(num);
+  std::vector<T> cg_tol(num);
+  for (unsigned int j = 0; j < num; ++j) {
+    rows.push_back(gsl::matrix_row(Z, j));
+    rows.push_back(gsl::matrix_row(Zt, j));
+    rows.push_back(gsl::matrix_row(Z12, j));
+    rows.push_back(gsl::matrix_row(Z_prev, j));
+    if (admm_data[j]->anderson_mem > 0)
+      aa[j] = AndersonAlloc<T>(admm_data[j]->anderson_mem, 2 * (m + n));
+    StateInit(admm_data[j], work, &rows[4 * j].vector,
+              &rows[4 * j + 1].vector, &rows[4 * j + 2].vector,
+              &rows[4 * j + 3].vector, aa[j], &st[j]);
+    order[j] = j;
+  }
+
+  // Row i < num_left holds problem order[i]. When a problem finishes, its
+  // rows are swapped with the last active ones, so that only the leading
+  // num_left rows need to be projected.
+  size_t num_left = num;
+  for (unsigned int k = 0; k < max_iter && num_left > 0; ++k) {
+    for (unsigned int i = 0; i < num_left; ++i) {
+      StateProx(&st[order[i]], k);
+      cg_tol[i] = st[order[i]].cg_tol;
+    }
+
+    // Project the active problems into the buffer of the previous iterates.
+    gsl::matrix_view<T> Z_next =
+        gsl::matrix_submatrix(Z_prev, 0, 0, num_left, m + n);
+    gsl::matrix_view<T> Zt_left =
+        gsl::matrix_submatrix(Zt, 0, 0, num_left, m + n);
+    gsl::matrix_view<T> X0_left;
+    if (X0 != 0)
+      X0_left = gsl::matrix_submatrix(X0, 0, 0, num_left, n);
+    ProjectBatch(work->proj, &Z_next.matrix, &Zt_left.matrix,
+                 X0 != 0 ? &X0_left.matrix : 0, cg_tol.data());
+    std::swap(Z, Z_prev);
+    for (unsigned int i = 0; i < num_left; ++i)
+      std::swap(st[order[i]].z, st[order[i]].z_prev);
+
+    for (unsigned int i = 0; i < num_left; ) {
+      unsigned int j = order[i];
+      if (!StateUpdate(&st[j], k) && k + 1 < admm_data[j]->max_iter) {
+        ++i;
+        continue;
+      }
+      StateFinish(&st[j]);
+
+      // Move the last active problem into row i, which is visited next.
+      unsigned int last = static_cast<unsigned int>(--num_left);
+      if (i == last)
+        continue;
+      unsigned int j_last = order[last];
+      SwapRows<T>(Z, i, last);
+      SwapRows<T>(Zt, i, last);
+      SwapRows<T>(Z12, i, last);
+      SwapRows<T>(Z_prev, i, last);
+      if (X0 != 0)
+        SwapRows<T>(X0, i, last);
+      std::swap(st[j].z, st[j_last].z);
+      std::swap(st[j].zt, st[j_last].zt);
+      std::swap(st[j].z12, st[j_last].z12);
+      std::swap(st[j].z_prev, st[j_last].z_prev);
+      order[i] = j_last;
+      order[last] = j;
+    }
+  }
+  for (unsigned int i = 0; i < num_left; ++i)
+    StateFinish(&st[order[i]]);
+
+  gsl::matrix_free(Z);
+  gsl::matrix_free(Zt);
+  gsl::matrix_free(Z12);
+  gsl::matrix_free(Z_prev);
+  if (X0 != 0)
+    gsl::matrix_free(X0);
+  for (unsigned int j = 0; j < num; ++j)
+    AndersonFree(aa[j]);
+
+  SetNumThreads(prev_threads);
+  return 0;
+}
+
+template <typename T, typename M>
+int SolverPath(AdmmWork<T, M> *work, AdmmData<T, M> *admm_data,
+               const std::vector<std::vector<FunctionObj<T> > > &f_path,
+               const std::vector<std::vector<FunctionObj<T> > > &g_path,
+               T *x_path, T *y_path) {
+  size_t m = admm_data->m;
+  size_t n = admm_data->n;
+  size_t num = std::max(f_path.size(), g_path.size());
+  bool bad_size = (!f_path.empty() && f_path.size() != num) ||
+      (!g_path.empty() && g_path.size() != num);
+  for (unsigned int k = 0; k < f_path.size(); ++k)
+    bad_size = bad_size || f_path[k].size() != m;
+  for (unsigned int k = 0; k < g_path.size(); ++k)
+    bad_size = bad_size || g_path[k].size() != n;
+  if (bad_size) {
+    fprintf(stderr, "ERROR: Path does not match the dimensions of A.\n");
+    return 1;
+  }
+  if (work == 0 || work->m != m || work->n != n ||
+      !ProjectorMatches(work->proj, admm_data->A)) {
+    fprintf(stderr, "ERROR: AdmmWork was not set up for this AdmmData.\n");
+    return 1;
+  }
+
+  // The iterates are passed from one solve to the next through buffers that
+  // temporarily replace the output pointers of admm_data, so that the warm
+  // start includes the dual variables even if the caller does not ask for
+  // them.
+  T *x_out = admm_data->x, *y_out = admm_data->y;
+  T *xt_out = admm_data->xt, *yt_out = admm_data->yt;
+  bool warm_start = admm_data->warm_start;
+  std::vector<T> x(n), y(m), xt(n), yt(m);
+  if (warm_start) {
+    if (x_out != 0)
+      std::copy(x_out, x_out + n, x.begin());
+    if (y_out != 0)
+      std::copy(y_out, y_out + m, y.begin());
+    if (xt_out != 0)
+      std::copy(xt_out, xt_out + n, xt.begin());
+    if (yt_out != 0)
+      std::copy(yt_out, yt_out + m, yt.begin());
+  }
+  admm_data->x = x.data();
+  admm_data->y = y.data();
+  admm_data->xt = xt.data();
+  admm_data->yt = yt.data();
+
+  std::vector<FunctionObj<T> > f, g;
+  f.swap(admm_data->f);
+  g.swap(admm_data->g);
+  for (unsigned int k = 0; k < num; ++k) {
+    admm_data->f = f_path.empty() ? f : f_path[k];
+    admm_data->g = g_path.empty() ? g : g_path[k];
+    Solver(work, admm_data);
+    admm_data->warm_start = true;
+    if (x_path != 0)
+      std::copy(x.begin(), x.end(), x_path + k * n);
+    if (y_path != 0)
+      std::copy(y.begin(), y.end(), y_path + k * m);
+  }
+  f.swap(admm_data->f);
+  g.swap(admm_data->g);
+
+  // Copy the solution of the last problem to output.
+  admm_data->x = x_out;
+  admm_data->y = y_out;
+  admm_data->xt = xt_out;
+  admm_data->yt = yt_out;
+  admm_data->warm_start = warm_start;
+  if (num > 0) {
+    if (x_out != 0)
+      std::copy(x.begin(), x.end(), x_out);
+    if (y_out != 0)
+      std::copy(y.begin(), y.end(), y_out);
+    if (xt_out != 0)
+      std::copy(xt.begin(), xt.end(), xt_out);
+    if (yt_out != 0)
+      std::copy(yt.begin(), yt.end(), yt_out);
+  }
+
+  return 0;
+}
+
+template <typename T, typename M>
+int Solver(AdmmData<T, M> *admm_data) {
+  AdmmWork<T, M> *work = SolverSetup(*admm_data);
+  if (work == 0)
+    return 1;
+  int err = Solver(work, admm_data);
+  SolverFree(work);
+  return err;
+}
+
+namespace {
+// Block of rows of a problem that is split by rows for consensus ADMM (block
+// splitting). Each block holds its rows of A and f and a local copy of x,
+// and the copies are driven to agreement through their average. The vectors
+// z, zt, z12 and z_prev have length n + m for the m rows of the block, and z
+// and z_prev are swapped after each projection.
+template <typename T, typename M>
+struct ConsensusBlock {
+  size_t m, n;
+  FunctionVec<T> f;
+
+  gsl::vector<T> *z, *zt, *z12, *z_prev;
+
+  // Projection onto the graph of the block, and the (unit) scaling of A.
+  Projector<M> *proj;
+  gsl::vector<T> *d, *e;
+  T cg_tol;
+};
+
+// Allocates a block for the m rows A of the problem in admm_data, with
+// functions f, and factors A according to the options in admm_data. A is not
+// equilibrated, since the column scaling would have to be shared by all
+// blocks. The iterates are zeroed (first touched) by the calling threads.
+// Returns null if A cannot be factored.
+template <typename T, typename M>
+ConsensusBlock<T, M> *BlockSetup(const AdmmData<T, M> &admm_data, const M &A,
+                                 size_t m, const FunctionVec<T> &f) {
+  size_t n = admm_data.n;
+  ConsensusBlock<T, M> *blk = new ConsensusBlock<T, M>;
+  blk->m = m;
+  blk->n = n;
+  blk->f = f;
+  blk->z = gsl::vector_alloc<T>(m + n);
+  blk->zt = gsl::vector_alloc<T>(m + n);
+  blk->z12 = gsl::vector_alloc<T>(m + n);
+  blk->z_prev = gsl::vector_alloc<T>(m + n);
+  gsl::vector_set_zero(blk->z);
+  gsl::vector_set_zero(blk->zt);
+  gsl::vector_set_zero(blk->z12);
+  gsl::vector_set_zero(blk->z_prev);
+  blk->d = gsl::vector_alloc<T>(m);
+  blk->e = gsl::vector_alloc<T>(n);
+  gsl::vector_set_all(blk->d, static_cast<T>(1));
+  gsl::vector_set_all(blk->e, static_cast<T>(1));
+  blk->proj = ProjectorSetup(A, m, n, 0u, admm_data.indirect,
+                             admm_data.cg_max_iter, admm_data.mixed_precision,
+                             admm_data.refine_iter, admm_data.explicit_inverse,
+                             blk->d, blk->e);
+  blk->cg_tol = static_cast<T>(0);
+  if (blk->proj == 0) {
+    BlockFree(blk);
+    return 0;
+  }
+  return blk;
+}
+
+template <typename T, typename M>
+void BlockFree(ConsensusBlock<T, M> *blk) {
+  if (blk->proj != 0)
+    ProjectorFree(blk->proj);
+  gsl::vector_free(blk->z);
+  gsl::vector_free(blk->zt);
+  gsl::vector_free(blk->z12);
+  gsl::vector_free(blk->z_prev);
+  gsl::vector_free(blk->d);
+  gsl::vector_free(blk->e);
+  delete blk;
+}
+
+// Initializes the iterates of a block from zero or, for each pointer that is
+// not null, from the warm start. Since (xt, yt) of the block is orthogonal to
+// the graph of A after each projection, the local xt is recovered as -A^T yt
+// if yt is given, and otherwise the dual variable xt of the whole problem is
+// shared equally by the num_blocks blocks.
+template <typename T, typename M>
+void BlockInit(ConsensusBlock<T, M> *blk, const T *x, const T *y,
+               const T *xt, const T *yt, size_t num_blocks) {
+  size_t m = blk->m;
+  size_t n = blk->n;
+  gsl::vector_set_zero(blk->z);
+  gsl::vector_set_zero(blk->zt);
+  gsl::vector_set_zero(blk->z12);
+  gsl::vector_set_zero(blk->z_prev);
+  for (unsigned int i = 0; i < n && x != 0; ++i)
+    gsl::vector_set(blk->z, i, x[i]);
+  for (unsigned int i = 0; i < m && y != 0; ++i)
+    gsl::vector_set(blk->z, n + i, y[i]);
+  for (unsigned int i = 0; i < n && xt != 0; ++i)
+    gsl::vector_set(blk->zt, i, xt[i] / static_cast<T>(num_blocks));
+  for (unsigned int i = 0; i < m && yt != 0; ++i)
+    gsl::vector_set(blk->zt, n + i, yt[i]);
+  if (yt != 0) {
+    gsl::vector_view<T> xt_blk = gsl::vector_subvector(blk->zt, 0, n);
+    gsl::vector_view<T> yt_blk = gsl::vector_subvector(blk->zt, n, m);
+    Gemv(blk->proj, CblasTrans, -static_cast<T>(1), &yt_blk.vector,
+         static_cast<T>(0), &xt_blk.vector);
+  }
+  blk->cg_tol = static_cast<T>(0);
+}
+
+// Adds the input x - xt of the block to the consensus sum v.
+template <typename T, typename M>
+void BlockSumInput(const ConsensusBlock<T, M> *blk, T *v) {
+  const T *z = blk->z->data;
+  const T *zt = blk->zt->data;
+  for (unsigned int i = 0; i < blk->n; ++i)
+    v[i] += z[i] - zt[i];
+}
+
+// Evaluates the proximal operator of g with penalty num_blocks * rho at the
+// average of the consensus sums v over num_blocks blocks, in place. This
+// minimizes g(x) + (rho / 2) sum_i ||x - v_i||_2^2 over the common x.
+template <typename T>
+void ConsensusProx(const FunctionVec<T> &g, T rho, size_t num_blocks, T *v) {
+  T num = static_cast<T>(num_blocks);
+  size_t n = g.size;
+  #pragma omp parallel for schedule(static) if (n >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < n; i += kProxChunk) {
+    size_t len = std::min<size_t>(kProxChunk, n - i);
+    for (unsigned int j = i; j < i + len; ++j)
+      v[j] /= num;
+    ProxEvalChunk(g, i, len, num * rho, v + i, v + i);
+  }
+}
+
+// Computes z12 = (x12, Prox{f}(y - yt)) for the consensus x12 and updates
+// the dual variable as in ProxDualUpdate(), then projects onto the graph of
+// the block. The CG tolerance of the first iteration is set relative to zt.
+template <typename T, typename M>
+void BlockIterate(ConsensusBlock<T, M> *blk, const T *x12, T rho, T alpha,
+                  T cg_tol, unsigned int k) {
+  const T kOne = static_cast<T>(1);
+  size_t n = blk->n;
+  const T *z = blk->z->data;
+  T *zt = blk->zt->data;
+  T *z12 = blk->z12->data;
+  for (unsigned int i = 0; i < n; ++i) {
+    z12[i] = x12[i];
+    zt[i] += alpha * z12[i] + (kOne - alpha) * z[i];
+  }
+  ProxDualUpdate(blk->f, rho, alpha, z + n, zt + n, z12 + n);
+  if (k == 0)
+    blk->cg_tol = cg_tol * gsl::blas_nrm2(blk->zt);
+
+  // Project into the buffer of the previous iterate and swap buffers.
+  gsl::vector_view<T> x = gsl::vector_subvector(blk->z_prev, 0, n);
+  gsl::vector_view<T> y = gsl::vector_subvector(blk->z_prev, n, blk->m);
+  gsl::vector_view<T> xt = gsl::vector_subvector(blk->zt, 0, n);
+  gsl::vector_view<T> yt = gsl::vector_subvector(blk->zt, n, blk->m);
+  Project(blk->proj, &x.vector, &y.vector, &xt.vector, &yt.vector,
+          blk->cg_tol);
+  std::swap(blk->z, blk->z_prev);
+}
+
+// Number of sums that make up the residuals of consensus ADMM, of which the
+// first kBlockSums are accumulated over blocks by BlockSums().
+const int kBlockSums = 9;
+const int kConsensusSums = 11;
+
+// Adds the sums of the block to sq[0], ..., sq[8]. These are ||x - x12||^2
+// (the consensus gap), ||A * x12 - y12||^2, ||x - x_prev||^2,
+// ||y - y_prev||^2, ||x||^2, ||y||^2, ||y12||^2, ||yt||^2 and f(y12), where
+// x12 is the consensus x. Also adds xt of the block to xt_sum. The y part of
+// z_prev serves as workspace, since it is overwritten by the next projection.
+template <typename T, typename M>
+void BlockSums(ConsensusBlock<T, M> *blk, T *sq, T *xt_sum) {
+  size_t m = blk->m;
+  size_t n = blk->n;
+  const T *z = blk->z->data;
+  const T *zt = blk->zt->data;
+  const T *z12 = blk->z12->data;
+  T *z_prev = blk->z_prev->data;
+  for (unsigned int i = 0; i < n; ++i) {
+    T gap_i = z[i] - z12[i];
+    T s_i = z[i] - z_prev[i];
+    sq[0] += gap_i * gap_i;
+    sq[2] += s_i * s_i;
+    sq[4] += z[i] * z[i];
+    xt_sum[i] += zt[i];
+  }
+  const T *y = z + n;
+  const T *yt = zt + n;
+  const T *y12 = z12 + n;
+  T *y_prev = z_prev + n;
+  T sq_s = 0, sq_y = 0, sq_y12 = 0, sq_yt = 0;
+  #pragma omp parallel for schedule(static) \
+      reduction(+:sq_s, sq_y, sq_y12, sq_yt) if (m >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < m; ++i) {
+    T s_i = y[i] - y_prev[i];
+    sq_s += s_i * s_i;
+    sq_y += y[i] * y[i];
+    sq_y12 += y12[i] * y12[i];
+    sq_yt += yt[i] * yt[i];
+  }
+  sq[3] += sq_s;
+  sq[5] += sq_y;
+  sq[6] += sq_y12;
+  sq[7] += sq_yt;
+  sq[8] += FuncEval(blk->f, y12);
+
+  gsl::vector_const_view<T> x12 = gsl::vector_const_subvector(blk->z12, 0, n);
+  gsl::vector_view<T> ax12 = gsl::vector_subvector(blk->z_prev, n, m);
+  Gemv(blk->proj, CblasNoTrans, static_cast<T>(1), &x12.vector,
+       static_cast<T>(0), &ax12.vector);
+  T sq_r = 0;
+  #pragma omp parallel for schedule(static) reduction(+:sq_r) \
+      if (m >= SOLVER_OMP_MIN_LEN)
+  for (unsigned int i = 0; i < m; ++i) {
+    T r_i = y_prev[i] - y12[i];
+    sq_r += r_i * r_i;
+  }
+  sq[1] += sq_r;
+}
+
+// Sets sq[9] and sq[10] to ||x12||^2 and ||xt||^2 for the consensus x12 and
+// the dual variable xt of x in the unsplit problem, which is the sum of those
+// of the blocks.
+template <typename T>
+void ConsensusSums(size_t n, const T *x12, const T *xt, T *sq) {
+  sq[9] = static_cast<T>(0);
+  sq[10] = static_cast<T>(0);
+  for (unsigned int i = 0; i < n; ++i) {
+    sq[9] += x12[i] * x12[i];
+    sq[10] += xt[i] * xt[i];
+  }
+}
+
+// Copies y12 and yt of the block to y and yt (where not null), and adds xt of
+// the block to xt_sum.
+template <typename T, typename M>
+void BlockFinish(const ConsensusBlock<T, M> *blk, T *y, T *xt_sum, T *yt) {
+  size_t n = blk->n;
+  const T *zt = blk->zt->data;
+  const T *z12 = blk->z12->data;
+  for (unsigned int i = 0; i < n; ++i)
+    xt_sum[i] += zt[i];
+  for (unsigned int i = 0; i < blk->m && y != 0; ++i)
+    y[i] = z12[n + i];
+  for (unsigned int i = 0; i < blk->m && yt != 0; ++i)
+    yt[i] = zt[n + i];
+}
+
+// Returns true if the residuals of consensus ADMM are needed in iteration k,
+// following the same schedule as Solver() with a fixed check interval.
+template <typename T, typename M>
+bool ConsensusCheckDue(const AdmmData<T, M> &admm_data, unsigned int k) {
+  bool update_rho = admm_data.adaptive_rho &&
+      k < admm_data.rho_max_iter &&
+      (k + 1) % std::max(admm_data.rho_interval, 1u) == 0;
+  return (k + 1) % std::max(admm_data.check_interval, 1u) == 0 ||
+      k + 1 >= admm_data.max_iter || update_rho ||
+      (!admm_data.quiet && k % 10 == 0);
+}
+
+// Evaluates the stopping criteria of consensus ADMM in iteration k from the
+// sums sq of BlockSums() over all blocks and ConsensusSums(), where obj_g is g
+// at the consensus x12, and prints progress if print is set. The residuals
+// and tolerances are sized like those of the unsplit problem in Solver(): the
+// primal residual combines the root mean square of the consensus gaps over
+// the blocks with the residual of y = A * x at (x12, y12), and the dual
+// residual combines the root mean square of the changes in the local x with
+// the change in y. Tightens the CG tolerance and rebalances rho as in
+// Solver(), in which case the scaled dual variables of all blocks must be
+// multiplied by *dual_scale. Returns true if converged.
+template <typename T, typename M>
+bool ConsensusCheck(const AdmmData<T, M> &admm_data, const T *sq,
+                    size_t num_blocks, T obj_g, T sqrtn_atol, unsigned int k,
+                    bool print, T *rho, T *cg_tol, T *dual_scale) {
+  T num = static_cast<T>(num_blocks);
+  T nrm_r = std::sqrt(sq[0] / num + sq[1]);
+  T nrm_s = *rho * std::sqrt(sq[2] / num + sq[3]);
+  T nrm_z = std::sqrt(sq[4] / num + sq[5]);
+  T nrm_z12 = std::sqrt(sq[9] + sq[6]);
+  T nrm_zt = std::sqrt(sq[10] + sq[7]);
+  T eps_pri = sqrtn_atol + admm_data.rel_tol * std::max(nrm_z12, nrm_z);
+  T eps_dual = sqrtn_atol + admm_data.rel_tol * *rho * nrm_zt;
+
+  bool converged = nrm_r <= eps_pri && nrm_s <= eps_dual;
+  if (print && (k % 10 == 0 || converged))
+    printf("%4d :  %.3e  %.3e  %.3e  %.3e  %.3e\n",
+           k, nrm_r, eps_pri, nrm_s, eps_dual, sq[8] + obj_g);
+
+  *dual_scale = static_cast<T>(1);
+  if (converged)
+    return true;
+  *cg_tol = admm_data.cg_tol * std::max(std::min(nrm_r, nrm_s / *rho),
+                                        std::min(eps_pri, eps_dual / *rho));
+
+  bool update_rho = admm_data.adaptive_rho &&
+      k < admm_data.rho_max_iter &&
+      (k + 1) % std::max(admm_data.rho_interval, 1u) == 0;
+  if (update_rho) {
+    T rho_new = *rho;
+    if (nrm_r > admm_data.rho_mu * nrm_s)
+      rho_new = std::min(*rho * admm_data.rho_tau, admm_data.rho_max);
+    else if (nrm_s > admm_data.rho_mu * nrm_r)
+      rho_new = std::max(*rho / admm_data.rho_tau, admm_data.rho_min);
+    *dual_scale = *rho / rho_new;
+    *rho = rho_new;
+  }
+  return false;
+}
+}  // namespace
+
+template <typename T>
+int SolverBlocks(AdmmData<T, T*> *admm_data, unsigned int num_blocks) {
+  size_t m = admm_data->m;
+  size_t n = admm_data->n;
+  if (num_blocks == 0 || num_blocks > m || !FunctionsMatch(*admm_data)) {
+    fprintf(stderr, "ERROR: Cannot split AdmmData into %u blocks.\n",
+            num_blocks);
+    return 1;
+  }
+  int prev_threads = SetNumThreads(static_cast<int>(admm_data->num_threads));
+
+  // Each block is owned by one thread of the outer team, which runs the
+  // kernels of its block with a nested team of team_size threads.
+  int team_size = 1;
+#ifdef _OPENMP
+  int num_threads = omp_get_max_threads();
+  int num_outer = std::min(num_threads, static_cast<int>(num_blocks));
+  team_size = std::max(num_threads / static_cast<int>(num_blocks), 1);
+  int prev_levels = omp_get_max_active_levels();
+  if (team_size > 1)
+    omp_set_max_active_levels(2);
+#endif
+
+  FunctionVec<T> f_tmp, g_tmp;
+  const FunctionVec<T> &f = Functions(admm_data->f, admm_data->f_vec, &f_tmp);
+  const FunctionVec<T> &g = Functions(admm_data->g, admm_data->g_vec, &g_tmp);
+  std::vector<size_t> row_begin(num_blocks + 1);
+  for (unsigned int b = 0; b <= num_blocks; ++b)
+    row_begin[b] = m * b / num_blocks;
+  std::vector<ConsensusBlock<T, T*>*> blk(num_blocks);
+  std::vector<std::vector<T> > A(num_blocks);
+  std::vector<T> v(num_blocks * n), sq(kConsensusSums * num_blocks), x12(n);
+
+  bool print = !admm_data->quiet;
+  if (print)
+    printf("%4s %12s %10s %10s %10s %10s\n",
+           "#", "r norm", "eps_pri", "s norm", "eps_dual", "objective");
+
+  T num = static_cast<T>(num_blocks);
+  T rho = admm_data->rho;
+  T sqrtn_atol = std::sqrt(static_cast<T>(n)) * admm_data->abs_tol;
+  T cg_tol = static_cast<T>(0), dual_scale = static_cast<T>(1);
+  bool converged = false;
+
+  // All loops over blocks use the same static schedule, so that each block
+  // is set up (first touched) and iterated by the same thread.
+  #pragma omp parallel num_threads(num_outer)
+  {
+    SetNumThreads(team_size);
+
+    #pragma omp for schedule(static)
+    for (unsigned int b = 0; b < num_blocks; ++b) {
+      size_t m_b = row_begin[b + 1] - row_begin[b];
+      const T *A_b = admm_data->A + row_begin[b] * n;
+      A[b].resize(m_b * n);
+      std::copy(A_b, A_b + m_b * n, A[b].begin());
+      blk[b] = BlockSetup<T, T*>(*admm_data, A[b].data(), m_b,
+                                 f.Slice(row_begin[b], row_begin[b + 1]));
+      if (admm_data->warm_start)
+        BlockInit(blk[b], admm_data->x,
+                  admm_data->y != 0 ? admm_data->y + row_begin[b] : 0,
+                  admm_data->xt,
+                  admm_data->yt != 0 ? admm_data->yt + row_begin[b] : 0,
+                  num_blocks);
+    }
+
+    for (unsigned int k = 0; k < admm_data->max_iter; ++k) {
+      #pragma omp for schedule(static)
+      for (unsigned int b = 0; b < num_blocks; ++b) {
+        std::fill(v.begin() + b * n, v.begin() + (b + 1) * n,
+                  static_cast<T>(0));
+        BlockSumInput(blk[b], v.data() + b * n);
+      }
+
+      // Average the local copies of x and evaluate the prox of g, as in
+      // ConsensusProx().
+      #pragma omp for schedule(static)
+      for (unsigned int i = 0; i < n; i += kProxChunk) {
+        size_t len = std::min<size_t>(kProxChunk, n - i);
+        for (unsigned int j = i; j < i + len; ++j) {
+          T sum = static_cast<T>(0);
+          for (unsigned int b = 0; b < num_blocks; ++b)
+            sum += v[b * n + j];
+          x12[j] = sum / num;
+        }
+        ProxEvalChunk(g, i, len, num * rho, x12.data() + i, x12.data() + i);
+      }
+
+      #pragma omp for schedule(static)
+      for (unsigned int b = 0; b < num_blocks; ++b)
+        BlockIterate(blk[b], x12.data(), rho, admm_data->alpha,
+                     admm_data->cg_tol, k);
+
+      if (!ConsensusCheckDue(*admm_data, k))
+        continue;
+      // The sums of xt of the blocks are accumulated in v.
+      #pragma omp for schedule(static)
+      for (unsigned int b = 0; b < num_blocks; ++b) {
+        std::fill(sq.begin() + kConsensusSums * b,
+                  sq.begin() + kConsensusSums * (b + 1), static_cast<T>(0));
+        std::fill(v.begin() + b * n, v.begin() + (b + 1) * n,
+                  static_cast<T>(0));
+        BlockSums(blk[b], sq.data() + kConsensusSums * b, v.data() + b * n);
+      }
+      #pragma omp single
+      {
+        for (unsigned int b = 1; b < num_blocks; ++b) {
+          for (int j = 0; j < kBlockSums; ++j)
+            sq[j] += sq[kConsensusSums * b + j];
+          for (unsigned int i = 0; i < n; ++i)
+            v[i] += v[b * n + i];
+        }
+        ConsensusSums(n, x12.data(), v.data(), sq.data());
+        converged = ConsensusCheck(*admm_data, sq.data(), num_blocks,
+                                   FuncEval(g, x12.data()), sqrtn_atol, k,
+                                   print, &rho, &cg_tol, &dual_scale);
+      }
+      if (converged)
+        break;
+      #pragma omp for schedule(static)
+      for (unsigned int b = 0; b < num_blocks; ++b) {
+        blk[b]->cg_tol = cg_tol;
+        if (dual_scale != static_cast<T>(1))
+          gsl::vector_scale(blk[b]->zt, dual_scale);
+      }
+    }
+  }
+
+  // Return the consensus x12 and the sum of the dual variables of the local
+  // copies of x, as in SolverMpi().
+  std::vector<T> xt_sum(n, static_cast<T>(0));
+  for (unsigned int b = 0; b < num_blocks; ++b) {
+    BlockFinish(blk[b], admm_data->y != 0 ? admm_data->y + row_begin[b] : 0,
+                xt_sum.data(),
+                admm_data->yt != 0 ? admm_data->yt + row_begin[b] : 0);
+    BlockFree(blk[b]);
+  }
   for (unsigned int i = 0; i < n && admm_data->x != 0; ++i)
-    admm_data->x[i] = gsl_vector_get(&x.vector, i);
+    admm_data->x[i] = x12[i];
+  for (unsigned int i = 0; i < n && admm_data->xt != 0; ++i)
+    admm_data->xt[i] = xt_sum[i];
+  admm_data->rho = rho;
 
-  // Free up memory.
-  gsl_matrix_free(L);
-  gsl_matrix_free(AA);
-  gsl_vector_free(z);
-  gsl_vector_free(zt);
-  gsl_vector_free(z12);
-  gsl_vector_free(z_prev);
+#ifdef _OPENMP
+  omp_set_max_active_levels(prev_levels);
+#endif
+  SetNumThreads(prev_threads);
+  return 0;
 }
 
+#ifdef SOLVER_MPI
+namespace {
+template <typename T>
+MPI_Datatype MpiType();
+
+template <>
+MPI_Datatype MpiType<double>() { return MPI_DOUBLE; }
+
+template <>
+MPI_Datatype MpiType<float>() { return MPI_FLOAT; }
+}  // namespace
+
+template <typename T, typename M>
+int SolverMpi(AdmmData<T, M> *admm_data, MPI_Comm comm) {
+  size_t m = admm_data->m;
+  size_t n = admm_data->n;
+  int rank, num_procs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &num_procs);
+  size_t num_blocks = static_cast<size_t>(num_procs);
+
+  // All processes return if the block of any process is inconsistent.
+  unsigned long long n_max = n;
+  MPI_Allreduce(MPI_IN_PLACE, &n_max, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX,
+                comm);
+  int bad = !FunctionsMatch(*admm_data) || n_max != n;
+  MPI_Allreduce(MPI_IN_PLACE, &bad, 1, MPI_INT, MPI_LOR, comm);
+  if (bad) {
+    if (rank == 0)
+      fprintf(stderr, "ERROR: AdmmData blocks do not match.\n");
+    return 1;
+  }
+  int prev_threads = SetNumThreads(static_cast<int>(admm_data->num_threads));
+  MPI_Datatype type = MpiType<T>();
+
+  FunctionVec<T> f_tmp, g_tmp;
+  const FunctionVec<T> &g = Functions(admm_data->g, admm_data->g_vec, &g_tmp);
+  ConsensusBlock<T, M> *blk = BlockSetup(
+      *admm_data, admm_data->A, m,
+      Functions(admm_data->f, admm_data->f_vec, &f_tmp));
+  int failed = blk == 0;
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, comm);
+  if (failed) {
+    if (blk != 0)
+      BlockFree(blk);
+    SetNumThreads(prev_threads);
+    return 1;
+  }
+  if (admm_data->warm_start)
+    BlockInit(blk, admm_data->x, admm_data->y, admm_data->xt, admm_data->yt,
+              num_blocks);
+
+  bool print = !admm_data->quiet && rank == 0;
+  if (print)
+    printf("%4s %12s %10s %10s %10s %10s\n",
+           "#", "r norm", "eps_pri", "s norm", "eps_dual", "objective");
+
+  // Each iteration exchanges the consensus sum of length n, and each check
+  // the sums of BlockSums() followed by the sum of xt.
+  T rho = admm_data->rho;
+  T sqrtn_atol = std::sqrt(static_cast<T>(n)) * admm_data->abs_tol;
+  std::vector<T> x12(n), sums(kConsensusSums + n);
+  for (unsigned int k = 0; k < admm_data->max_iter; ++k) {
+    std::fill(x12.begin(), x12.end(), static_cast<T>(0));
+    BlockSumInput(blk, x12.data());
+    MPI_Allreduce(MPI_IN_PLACE, x12.data(), static_cast<int>(n), type,
+                  MPI_SUM, comm);
+    ConsensusProx(g, rho, num_blocks, x12.data());
+    BlockIterate(blk, x12.data(), rho, admm_data->alpha, admm_data->cg_tol,
+                 k);
+
+    if (!ConsensusCheckDue(*admm_data, k))
+      continue;
+    T *sq = sums.data();
+    std::fill(sums.begin(), sums.end(), static_cast<T>(0));
+    BlockSums(blk, sq, sq + kConsensusSums);
+    MPI_Allreduce(MPI_IN_PLACE, sq, static_cast<int>(kConsensusSums + n),
+                  type, MPI_SUM, comm);
+    ConsensusSums(n, x12.data(), sq + kConsensusSums, sq);
+    T dual_scale;
+    if (ConsensusCheck(*admm_data, sq, num_blocks, FuncEval(g, x12.data()),
+                       sqrtn_atol, k, print, &rho, &blk->cg_tol,
+                       &dual_scale))
+      break;
+    if (dual_scale != static_cast<T>(1))
+      gsl::vector_scale(blk->zt, dual_scale);
+  }
+
+  // Return the consensus x12, at which g was evaluated, and the sum of the
+  // dual variables of the local copies of x, which is the dual variable of x
+  // in the unsplit problem.
+  std::vector<T> xt_sum(n, static_cast<T>(0));
+  BlockFinish(blk, admm_data->y, xt_sum.data(), admm_data->yt);
+  MPI_Allreduce(MPI_IN_PLACE, xt_sum.data(), static_cast<int>(n), type,
+                MPI_SUM, comm);
+  for (unsigned int i = 0; i < n && admm_data->x != 0; ++i)
+    admm_data->x[i] = x12[i];
+  for (unsigned int i = 0; i < n && admm_data->xt != 0; ++i)
+    admm_data->xt[i] = xt_sum[i];
+  admm_data->rho = rho;
+
+  BlockFree(blk);
+  SetNumThreads(prev_threads);
+  return 0;
+}
+#endif  // SOLVER_MPI
+
+template <typename T>
+int MappedMatrixOpen(const char *path, MappedMatrix<T> *A,
+                     size_t block_rows) {
+  // Rows are read in blocks of about 64 MB by default.
+  const size_t kBlockBytes = static_cast<size_t>(64) << 20;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: Cannot open matrix file %s.\n", path);
+    return 1;
+  }
+  unsigned long long header[4];
+  struct stat st;
+  bool valid = fstat(fd, &st) == 0 &&
+      read(fd, header, sizeof(header)) == static_cast<ssize_t>(sizeof(header))
+      && header[0] == kMappedMatrixMagic && header[3] == sizeof(T) &&
+      static_cast<unsigned long long>(st.st_size) ==
+          sizeof(header) + header[1] * header[2] * sizeof(T);
+  void *map = MAP_FAILED;
+  if (valid)
+    map = mmap(0, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd,
+               0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "ERROR: %s is not a valid matrix file.\n", path);
+    return 1;
+  }
+  A->map = map;
+  A->map_len = static_cast<size_t>(st.st_size);
+  A->val = reinterpret_cast<const T*>(static_cast<const char*>(map) +
+                                      sizeof(header));
+  A->m = static_cast<size_t>(header[1]);
+  A->n = static_cast<size_t>(header[2]);
+  A->block_rows = block_rows;
+  if (block_rows == 0) {
+    size_t row_bytes = std::max(A->n, static_cast<size_t>(1)) * sizeof(T);
+    A->block_rows = std::max(kBlockBytes / row_bytes, static_cast<size_t>(1));
+  }
+  return 0;
+}
+
+template <typename T>
+void MappedMatrixClose(MappedMatrix<T> *A) {
+  if (A->map != 0)
+    munmap(A->map, A->map_len);
+  *A = MappedMatrix<T>();
+}
+
+template <typename T>
+int MappedMatrixWrite(const char *path, const T *A, size_t m, size_t n) {
+  unsigned long long header[4] = { kMappedMatrixMagic, m, n, sizeof(T) };
+  FILE *file = fopen(path, "wb");
+  if (file == 0) {
+    fprintf(stderr, "ERROR: Cannot open matrix file %s.\n", path);
+    return 1;
+  }
+  bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+      fwrite(A, sizeof(T), m * n, file) == m * n;
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "ERROR: Cannot write matrix file %s.\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+template AdmmWork<double, double*> *SolverSetup(
+    const AdmmData<double, double*> &);
+template int Solver(AdmmWork<double, double*> *, AdmmData<double, double*> *);
+template void SolverFree(AdmmWork<double, double*> *);
+template int Solver(AdmmData<double, double*> *);
+template int SolverBatch(
+    AdmmWork<double, double*> *,
+    const std::vector<AdmmData<double, double*>*> &);
+template int SolverPath(
+    AdmmWork<double, double*> *, AdmmData<double, double*> *,
+    const std::vector<std::vector<FunctionObj<double> > > &,
+    const std::vector<std::vector<FunctionObj<double> > > &,
+    double *, double *);
+
+template AdmmWork<float, float*> *SolverSetup(
+    const AdmmData<float, float*> &);
+template int Solver(AdmmWork<float, float*> *, AdmmData<float, float*> *);
+template void SolverFree(AdmmWork<float, float*> *);
+template int Solver(AdmmData<float, float*> *);
+template int SolverBatch(
+    AdmmWork<float, float*> *,
+    const std::vector<AdmmData<float, float*>*> &);
+template int SolverPath(
+    AdmmWork<float, float*> *, AdmmData<float, float*> *,
+    const std::vector<std::vector<FunctionObj<float> > > &,
+    const std::vector<std::vector<FunctionObj<float> > > &, float *, float *);
+
+template AdmmWork<double, CsrMatrix<double> > *SolverSetup(
+    const AdmmData<double, CsrMatrix<double> > &);
+template int Solver(AdmmWork<double, CsrMatrix<double> > *,
+                    AdmmData<double, CsrMatrix<double> > *);
+template void SolverFree(AdmmWork<double, CsrMatrix<double> > *);
+template int Solver(AdmmData<double, CsrMatrix<double> > *);
+template int SolverBatch(
+    AdmmWork<double, CsrMatrix<double> > *,
+    const std::vector<AdmmData<double, CsrMatrix<double> >*> &);
+template int SolverPath(
+    AdmmWork<double, CsrMatrix<double> > *,
+    AdmmData<double, CsrMatrix<double> > *,
+    const std::vector<std::vector<FunctionObj<double> > > &,
+    const std::vector<std::vector<FunctionObj<double> > > &,
+    double *, double *);
+
+template AdmmWork<float, CsrMatrix<float> > *SolverSetup(
+    const AdmmData<float, CsrMatrix<float> > &);
+template int Solver(AdmmWork<float, CsrMatrix<float> > *,
+                    AdmmData<float, CsrMatrix<float> > *);
+template void SolverFree(AdmmWork<float, CsrMatrix<float> > *);
+template int Solver(AdmmData<float, CsrMatrix<float> > *);
+template int SolverBatch(
+    AdmmWork<float, CsrMatrix<float> > *,
+    const std::vector<AdmmData<float, CsrMatrix<float> >*> &);
+template int SolverPath(
+    AdmmWork<float, CsrMatrix<float> > *,
+    AdmmData<float, CsrMatrix<float> > *,
+    const std::vector<std::vector<FunctionObj<float> > > &,
+    const std::vector<std::vector<FunctionObj<float> > > &, float *, float *);
+
+template AdmmWork<double, MappedMatrix<double> > *SolverSetup(
+    const AdmmData<double, MappedMatrix<double> > &);
+template int Solver(AdmmWork<double, MappedMatrix<double> > *,
+                    AdmmData<double, MappedMatrix<double> > *);
+template void SolverFree(AdmmWork<double, MappedMatrix<double> > *);
+template int Solver(AdmmData<double, MappedMatrix<double> > *);
+template int SolverBatch(
+    AdmmWork<double, MappedMatrix<double> > *,
+    const std::vector<AdmmData<double, MappedMatrix<double> >*> &);
+template int SolverPath(
+    AdmmWork<double, MappedMatrix<double> > *,
+    AdmmData<double, MappedMatrix<double> > *,
+    const std::vector<std::vector<FunctionObj<double> > > &,
+    const std::vector<std::vector<FunctionObj<double> > > &,
+    double *, double *);
+
+template AdmmWork<float, MappedMatrix<float> > *SolverSetup(
+    const AdmmData<float, MappedMatrix<float> > &);
+template int Solver(AdmmWork<float, MappedMatrix<float> > *,
+                    AdmmData<float, MappedMatrix<float> > *);
+template void SolverFree(AdmmWork<float, MappedMatrix<float> > *);
+template int Solver(AdmmData<float, MappedMatrix<float> > *);
+template int SolverBatch(
+    AdmmWork<float, MappedMatrix<float> > *,
+    const std::vector<AdmmData<float, MappedMatrix<float> >*> &);
+template int SolverPath(
+    AdmmWork<float, MappedMatrix<float> > *,
+    AdmmData<float, MappedMatrix<float> > *,
+    const std::vector<std::vector<FunctionObj<float> > > &,
+    const std::vector<std::vector<FunctionObj<float> > > &, float *, float *);
+
+template int MappedMatrixOpen(const char *, MappedMatrix<double> *, size_t);
+template void MappedMatrixClose(MappedMatrix<double> *);
+template int MappedMatrixWrite(const char *, const double *, size_t, size_t);
+template int MappedMatrixOpen(const char *, MappedMatrix<float> *, size_t);
+template void MappedMatrixClose(MappedMatrix<float> *);
+template int MappedMatrixWrite(const char *, const float *, size_t, size_t);
+
+template int SolverBlocks(AdmmData<double, double*> *, unsigned int);
+template int SolverBlocks(AdmmData<float, float*> *, unsigned int);
+
+#ifdef SOLVER_MPI
+template int SolverMpi(AdmmData<double, double*> *, MPI_Comm);
+template int SolverMpi(AdmmData<float, float*> *, MPI_Comm);
+template int SolverMpi(AdmmData<double, CsrMatrix<double> > *, MPI_Comm);
+template int SolverMpi(AdmmData<float, CsrMatrix<float> > *, MPI_Comm);
+template int SolverMpi(AdmmData<double, MappedMatrix<double> > *, MPI_Comm);
+template int SolverMpi(AdmmData<float, MappedMatrix<float> > *, MPI_Comm);
+#endif  // SOLVER_MPI
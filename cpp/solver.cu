@@ -19,7 +19,7 @@ template <typename T>
 void RowToColMajor(const T *Arm, size_t m, size_t n, T *Acm);
 
 template <typename T, typename M>
-void Solver(AdmmData<T, M> *admm_data) {
+int Solver(AdmmData<T, M> *admm_data) {
   // Extract values from admm_data
   size_t n = admm_data->n;
   size_t m = admm_data->m;
@@ -144,6 +144,7 @@ void Solver(AdmmData<T, M> *admm_data) {
   cml::vector_free(&zt);
   cml::vector_free(&z12);
   cml::vector_free(&z_prev);
+  return 0;
 }
 
 template <typename T>
@@ -153,6 +154,6 @@ void RowToColMajor(const T *Arm, size_t m, size_t n, T *Acm) {
       Acm[j * m + i] = Arm[i * n + j];
 }
 
-template void Solver<double>(AdmmData<double, double*> *);
-template void Solver<float>(AdmmData<float, float*> *);
+template int Solver<double>(AdmmData<double, double*> *);
+template int Solver<float>(AdmmData<float, float*> *);
 
@@ -3,34 +3,261 @@
 
 #include <vector>
 
+#ifdef SOLVER_MPI
+#include <mpi.h>
+#endif
+
 #include "prox_lib.hpp"
 
+// Sparse matrix in compressed sparse row (CSR) format, for use as the matrix
+// type M in AdmmData. The nonzeros of row i are val[row_ptr[i]], ...,
+// val[row_ptr[i + 1] - 1] and lie in the columns given by col_ind. A matrix
+// in compressed sparse column format can be passed as the CSR form of A^T.
+template <typename T>
+struct CsrMatrix {
+  const T *val;
+  const int *col_ind, *row_ptr;
+
+  CsrMatrix(const T *val, const int *col_ind, const int *row_ptr)
+      : val(val), col_ind(col_ind), row_ptr(row_ptr) { }
+};
+
+// Dense row-major matrix in a memory-mapped binary file, for use as the
+// matrix type M in AdmmData when A does not fit in memory. The file consists
+// of a header of four 64-bit unsigned integers (kMappedMatrixMagic, m, n,
+// sizeof(T)) followed by the m * n entries of A. The solver reads A in blocks
+// of block_rows rows, so that only a few blocks need to be resident at a
+// time. Equilibration and mixed precision are not supported.
+template <typename T>
+struct MappedMatrix {
+  const T *val;
+  size_t m, n, block_rows;
+
+  // Mapping of the whole file.
+  void *map;
+  size_t map_len;
+
+  MappedMatrix()
+      : val(0), m(0), n(0), block_rows(0), map(0), map_len(0) { }
+};
+
+// File signature "ADMMMAT1" in little-endian byte order.
+const unsigned long long kMappedMatrixMagic = 0x3154414d4d4d4441ULL;
+
+// Maps the matrix file at path into memory and sets up A to read it in
+// blocks of block_rows rows, where 0 selects blocks of about 64 MB. Returns
+// 0 on success and 1 if the file cannot be mapped or is not a valid matrix
+// file for element type T.
+template <typename T>
+int MappedMatrixOpen(const char *path, MappedMatrix<T> *A,
+                     size_t block_rows);
+
+// Unmaps a matrix opened with MappedMatrixOpen().
+template <typename T>
+void MappedMatrixClose(MappedMatrix<T> *A);
+
+// Writes the m x n row-major matrix A to path in the format read by
+// MappedMatrixOpen(). Returns 0 on success and 1 on failure.
+template <typename T>
+int MappedMatrixWrite(const char *path, const T *A, size_t m, size_t n);
+
+// Setting of options that can be selected automatically.
+enum Choice { kOff, kOn, kAuto };
+
 // Data structure for input to Solver().
 template <typename T, typename M>
 struct AdmmData {
   // Input.
   std::vector<FunctionObj<T> > f, g;
   const M A;
+
+  // Compact alternative to f and g (CPU solvers only), which is used in place
+  // of f (g) if that is empty. For problems with many rows this avoids
+  // storing all four parameters of each element, e.g. f_vec =
+  // FunctionVec<T>(m, FunctionObj<T>(kSquare)) with f_vec.b holding the
+  // right-hand side.
+  FunctionVec<T> f_vec, g_vec;
   size_t m, n;
 
   // Output.
   T *x, *y;
 
-  // Parameters.
-  T rho;
+  // Scaled dual variables (optional output). If warm_start is set, then
+  // (x, y, xt, yt) are also used to initialize the solver. Null pointers are
+  // ignored and the corresponding variables start at zero.
+  T *xt, *yt;
+
+  // Parameters. The over-relaxation parameter alpha should lie in (0, 2),
+  // where alpha = 1 corresponds to plain ADMM.
+  T rho, alpha;
   unsigned int max_iter;
   T rel_tol, abs_tol;
-  bool quiet;
+  bool quiet, warm_start;
+
+  // Number of Ruiz equilibration passes applied to A by SolverSetup() (0
+  // disables equilibration). The solver rescales f and g accordingly and
+  // returns (x, y, xt, yt) in the original scaling.
+  unsigned int equil_iter;
+
+  // Adaptive penalty (residual balancing). If adaptive_rho is set, then every
+  // rho_interval iterations up to iteration rho_max_iter, rho is multiplied
+  // (divided) by rho_tau whenever the primal (dual) residual exceeds rho_mu
+  // times the dual (primal) residual, subject to rho_min <= rho <= rho_max.
+  // On exit rho holds the final penalty, which matches the scaling of
+  // (xt, yt). A rho_interval of 0 is not valid and is treated as 1.
+  bool adaptive_rho;
+  unsigned int rho_interval, rho_max_iter;
+  T rho_mu, rho_tau, rho_min, rho_max;
+
+  // Anderson acceleration. If anderson_mem > 0, then (z, zt) is extrapolated
+  // from the last anderson_mem iterations, using type-I acceleration if
+  // anderson_type1 is set and type-II otherwise. An extrapolated step is
+  // rejected (and the memory cleared) if it increases the fixed-point
+  // residual by more than a factor anderson_safeguard. The least squares
+  // problem is regularized by anderson_reg.
+  unsigned int anderson_mem;
+  bool anderson_type1;
+  T anderson_safeguard, anderson_reg;
+
+  // Indirect projection. If indirect is set, then SolverSetup() does not
+  // factor A. Instead, each projection solves (I + A^TA) x = xt + A^T yt by
+  // Jacobi preconditioned conjugate gradient (CG), warm started from the
+  // previous solution. CG stops once the residual falls below cg_tol times
+  // the current ADMM residual, or after cg_max_iter iterations.
+  bool indirect;
+  unsigned int cg_max_iter;
+  T cg_tol;
+
+  // Mixed precision (dense A only, intended for T = double). If
+  // mixed_precision is set, then SolverSetup() stores A and the Cholesky
+  // factor in single precision. Each projection is solved with the single
+  // precision factor followed by refine_iter steps of iterative refinement in
+  // precision T, so that the ADMM iterates retain full precision. Ignored if
+  // the projection is indirect.
+  bool mixed_precision;
+  unsigned int refine_iter;
+
+  // Explicit projection (dense A with direct factorization only). If on,
+  // SolverSetup() forms the inverse of (I + A^TA) or (I + AA^T) from its
+  // Cholesky factor, so that each projection applies one symmetric
+  // matrix-vector product instead of two triangular solves (and, if A is
+  // fat, the product with AA^T is also avoided). kAuto enables it when
+  // min(m, n) is small compared to max(m, n), such that forming the inverse
+  // costs little compared to forming A^TA or AA^T. Ignored with mixed
+  // precision or indirect projection.
+  Choice explicit_inverse;
+
+  // Convergence checks. The residual norms and objective are only computed
+  // every check_interval iterations (and whenever they are needed for output
+  // or for adapting rho), so that the iterations in between require no
+  // reductions. If adaptive_check is set, check_interval is the largest
+  // interval used, and checks become more frequent as the residuals approach
+  // the tolerances.
+  unsigned int check_interval;
+  bool adaptive_check;
+
+  // Number of OpenMP threads used by SolverSetup() and the solvers, where 0
+  // keeps the OpenMP default (OMP_NUM_THREADS). The previous setting is
+  // restored on return. Ignored if compiled without OpenMP.
+  unsigned int num_threads;
 
   // Constructor.
   AdmmData(const M &A, size_t m, size_t n)
-      : A(A), m(m), n(n), rho(static_cast<T>(1)), max_iter(1000),
-        rel_tol(static_cast<T>(1e-3)), abs_tol(static_cast<T>(1e-4)),
-        quiet(false) { }
+      : A(A), m(m), n(n), xt(0), yt(0), rho(static_cast<T>(1)),
+        alpha(static_cast<T>(1)), max_iter(1000), rel_tol(static_cast<T>(1e-3)),
+        abs_tol(static_cast<T>(1e-4)), quiet(false), warm_start(false),
+        equil_iter(0), adaptive_rho(false), rho_interval(10),
+        rho_max_iter(500),
+        rho_mu(static_cast<T>(10)), rho_tau(static_cast<T>(2)),
+        rho_min(static_cast<T>(1e-4)), rho_max(static_cast<T>(1e4)),
+        anderson_mem(0), anderson_type1(false),
+        anderson_safeguard(static_cast<T>(2)),
+        anderson_reg(static_cast<T>(1e-10)), indirect(false),
+        cg_max_iter(100), cg_tol(static_cast<T>(0.1)),
+        mixed_precision(false), refine_iter(1), explicit_inverse(kAuto),
+        check_interval(1), adaptive_check(false), num_threads(0) { }
 };
 
+// Persistent solver state for repeated solves with the same A. Holds the
+// factorization of (I + A^TA) or (I + AA^T) and the ADMM iterates, so that
+// only f and g need to change between calls (see the factors argument of
+// <admm_graph_form>/matlab/admm.m).
+template <typename T, typename M>
+struct AdmmWork;
+
+// Allocates a workspace and factors A (unless admm_data.indirect is set). The
+// workspace must be released with SolverFree(). Returns null if A cannot be
+// factored, which happens for sparse A if the LDL^T factorization of
+// [I A^T; A -I] meets a zero pivot.
+template <typename T, typename M>
+AdmmWork<T, M> *SolverSetup(const AdmmData<T, M> &admm_data);
+
+// Solves the problem in admm_data, reusing the factorization in work.
+// Returns 0 on success and 1 if admm_data does not match the workspace.
+template <typename T, typename M>
+int Solver(AdmmWork<T, M> *work, AdmmData<T, M> *admm_data);
+
+// Solves several problems that share A, but may differ in f, g and all other
+// parameters, using the factorization in work. The iterations are run in
+// lockstep, such that the projections of all problems are carried out
+// together by matrix-matrix operations, and each problem stops on its own
+// criteria, after which it is left out of the projections. The number of
+// threads is taken from the first problem. Returns 0 on success and 1 if any
+// problem does not match the workspace, in which case none are solved.
+template <typename T, typename M>
+int SolverBatch(AdmmWork<T, M> *work,
+                const std::vector<AdmmData<T, M>*> &admm_data);
+
+// Solves a sequence of problems, such as a regularization path, where
+// problem k is admm_data with f replaced by f_path[k] and g replaced by
+// g_path[k]. Either path may be empty, in which case admm_data->f (or
+// admm_data->g) is used for all problems. Each problem is warm started from
+// the solution of the previous one, and the first from (x, y, xt, yt) if
+// admm_data->warm_start is set. If not null, x_path and y_path receive the
+// solutions in rows of length n and m. On exit, admm_data holds the solution
+// of the last problem. Returns 0 on success and 1 if the paths or admm_data
+// do not match the workspace.
+template <typename T, typename M>
+int SolverPath(AdmmWork<T, M> *work, AdmmData<T, M> *admm_data,
+               const std::vector<std::vector<FunctionObj<T> > > &f_path,
+               const std::vector<std::vector<FunctionObj<T> > > &g_path,
+               T *x_path, T *y_path);
+
+// Frees all memory associated with work.
+template <typename T, typename M>
+void SolverFree(AdmmWork<T, M> *work);
+
+// Equivalent to SolverSetup(), Solver() and SolverFree() in sequence.
+// Returns 0 on success and 1 if either SolverSetup() or Solver() fails.
+template <typename T, typename M>
+int Solver(AdmmData<T, M> *admm_data);
+
+// Solves the problem in admm_data (dense A) by splitting A into num_blocks
+// blocks of rows, which are coordinated by consensus ADMM as in SolverMpi().
+// Each block is copied, factored and iterated by its own team of
+// num_threads / num_blocks OpenMP threads, such that with pinned threads
+// each team only streams memory on its own NUMA node. Supports the same
+// options as SolverMpi(). Returns 0 on success and 1 if num_blocks is 0 or
+// larger than m.
+template <typename T>
+int SolverBlocks(AdmmData<T, T*> *admm_data, unsigned int num_blocks);
+
+#ifdef SOLVER_MPI
+// Solves the problem in admm_data by block splitting across the processes of
+// comm, which must all call SolverMpi(). On each process, admm_data holds a
+// block of rows of A, with the corresponding entries of f and y, while n, g
+// and the parameters are the same on all processes. Each process factors
+// its own block and keeps a local copy of x, and only the averages of these
+// copies are exchanged (consensus ADMM). The stopping criteria are sized
+// like those of Solver(), with the gap between the local copies and their
+// consensus added to the primal residual. On exit, x is the consensus at
+// which g was evaluated, and x and xt are the same on all processes.
+// Equilibration, Anderson acceleration and adaptive convergence checks are
+// not supported. Returns 0 on success and 1 if the blocks do not match or a
+// block cannot be factored (see SolverSetup()), on all processes.
 template <typename T, typename M>
-void Solver(AdmmData<T, M> *admm_data);
+int SolverMpi(AdmmData<T, M> *admm_data, MPI_Comm comm);
+#endif  // SOLVER_MPI
 
 #endif /* SOLVER_HPP_ */
 